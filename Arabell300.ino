@@ -20,6 +20,8 @@
 #include "config.h"
 #include "afsk.h"
 #include "hayes.h"
+#include "sched.h"
+#include "host.h"
 
 // Persistent modem configuration
 CFG_t cfg;
@@ -30,6 +32,67 @@ AFSK afsk;
 // The AT-Hayes command interface
 HAYES hayes(&cfg, &afsk);
 
+#if PWR_DOWN > 0
+// Idle since, for power down
+uint32_t idleSince = 0;
+#endif
+
+// Task names
+const char tskEvents[]  PROGMEM = "EVENTS";
+const char tskRing[]    PROGMEM = "RING";
+const char tskEscape[]  PROGMEM = "ESCAPE";
+const char tskDTR[]     PROGMEM = "DTR";
+const char tskFlow[]    PROGMEM = "FLOW";
+const char tskData[]    PROGMEM = "DATA";
+const char tskSpill[]   PROGMEM = "SPILL";
+const char tskOutput[]  PROGMEM = "OUTPUT";
+const char tskCommand[] PROGMEM = "COMMAND";
+
+/**
+  Print the result of a serial I/O task, if any, or send it as a frame
+  under host control
+
+  @param result the serial I/O event or result code
+*/
+void sioResult(uint8_t result) {
+  if (result != SIO_NONE) {
+    if (host.isActive())
+      host.doEvent(result);
+    else
+      hayes.doSIO(result);
+  }
+}
+
+// The tasks: the modem tasks report their results to the command interface
+void taskEvents()       { sioResult(afsk.doEvents()); }
+void taskRing()         { sioResult(afsk.doRing()); }
+void taskEscape()       { sioResult(afsk.doEscape()); }
+void taskDTR()          { sioResult(afsk.doDTR()); }
+void taskFlow()         { afsk.doFlow(); }
+void taskData()         { sioResult(afsk.doData()); }
+void taskSpill()        { afsk.doSpill(); }
+void taskOutput()       { hayes.doOutput(); }
+void taskCommand()      {
+  // Host control frames or AT commands
+  if (host.isActive())
+    sioResult(host.doSIO());
+  else
+    hayes.doSIO();
+#if PWR_DOWN > 0
+  // Keep the time of the last char
+  idleSince = millis();
+#endif
+}
+
+// The event checks
+bool readyEvents()      { return afsk.hasEvents(); }
+bool readyRing()        { return afsk.hasRing(); }
+bool readyDTR()         { return afsk.hasDTR(); }
+bool readyData()        { return afsk.hasData(); }
+bool readySpill()       { return afsk.hasSpill(); }
+bool readyOutput()      { return hayes.hasOutput(); }
+bool readyCommand()     { return afsk.hasCommand() and not hayes.isBusy(); }
+
 
 /**
   ADC Interrupt vector, called for each sample
@@ -37,12 +100,28 @@ HAYES hayes(&cfg, &afsk);
 ISR(ADC_vect) {
   // Clear the Interrupt Flag Register
   TIFR1 = _BV(ICF1);
+  // Note the wake up time, if sleeping
+  sched.wake();
 #ifndef DEBUG
   // Hadle TX/RX
   afsk.doTXRX();
 #endif
 }
 
+/**
+  External Interrupt 0 vector, RING input falling edge
+*/
+ISR(INT0_vect) {
+  afsk.ringEdge();
+}
+
+/**
+  Pin Change Interrupt 2 vector, DTR input change
+*/
+ISR(PCINT2_vect) {
+  afsk.dtrEdge();
+}
+
 /**
   Main Arduino setup function
 */
@@ -52,11 +131,25 @@ void setup() {
   Serial.begin(115200);
   e2hex();
 #else
-  Serial.begin(300);
+  // The DTE serial speed from the profile
+  hayes.setDTERate();
 #endif
 
   // Define and configure the modem
   afsk.init(BELL103, &cfg);
+  // The host control works on the same
+  host.init(&cfg, &afsk);
+
+  // The tasks, in order of priority
+  sched.add(tskEvents,  taskEvents,  readyEvents);
+  sched.add(tskRing,    taskRing,    readyRing);
+  sched.add(tskEscape,  taskEscape,  (uint16_t)20);
+  sched.add(tskDTR,     taskDTR,     readyDTR);
+  sched.add(tskFlow,    taskFlow,    (uint16_t)10);
+  sched.add(tskSpill,   taskSpill,   readySpill);
+  sched.add(tskData,    taskData,    readyData);
+  sched.add(tskOutput,  taskOutput,  readyOutput);
+  sched.add(tskCommand, taskCommand, readyCommand);
 
   // All LEDs on
   afsk.setLeds(ON);
@@ -73,10 +166,22 @@ void setup() {
   Main Arduino loop
 */
 void loop() {
-  // Check the serial port and handle data
-  uint8_t sioResult = afsk.doSIO();
-  if      (sioResult == 255)  hayes.doSIO();
-  else if (sioResult != 254)  hayes.doSIO(sioResult);
+  // Run the tasks which are due, sleep if there was nothing to do
+  if (not sched.run()) {
+#if PWR_DOWN > 0
+    // Power down after some time idle, on-hook
+    if (not afsk.isIdle())
+      idleSince = millis();
+    else if (millis() - idleSince >= PWR_DOWN * 1000UL) {
+      afsk.powerDown();
+      sched.pwrDowns++;
+      idleSince = millis();
+    }
+#endif
+#ifndef DEBUG
+    sched.sleep();
+#endif
+  }
 
 #ifdef DEBUG_RX_LVL
   static uint32_t next = millis();
@@ -86,6 +191,20 @@ void loop() {
   }
 #endif
 
+#ifdef DEBUG_CYCLES
+  static uint32_t nextCyc = millis();
+  if (millis() > nextCyc) {
+    // Maximum and average CPU cycles per sample, in doTXRX
+    Serial.print(afsk.cycMax);
+    Serial.print(",");
+    Serial.println(afsk.cycSum / afsk.cycCnt);
+    afsk.cycMax = 0;
+    afsk.cycSum = 0;
+    afsk.cycCnt = 0;
+    nextCyc += 1000;
+  }
+#endif
+
 #ifdef DEBUG
   afsk.simFeed();
   afsk.simPrint();
@@ -22,7 +22,9 @@
     Francesco Sacchi https://github.com/develersrl/bertos/blob/master/bertos/net/afsk.c
 */
 
+#include <util/atomic.h>
 #include "afsk.h"
+#include "dsp.h"
 
 #define cbi(sfr, bit) (_SFR_BYTE(sfr) &= ~_BV(bit))
 #define sbi(sfr, bit) (_SFR_BYTE(sfr) |= _BV(bit))
@@ -34,13 +36,16 @@ WAVE wave;
 // The DTMF wave generator
 DTMF dtmf;
 
-// FIFOs
-const uint8_t fifoSize = 4;
+// FIFOs, large enough to buffer a faster DTE while the flow control
+// paces it to the line
+const uint8_t fifoSize = FIFO_BITS;
 const uint8_t fifoLow =  1 << (fifoSize - 2);
 const uint8_t fifoMed =  1 << (fifoSize - 1);
 const uint8_t fifoHgh = (1 << fifoSize) - fifoLow;
 FIFO txFIFO(fifoSize);
 FIFO rxFIFO(fifoSize);
+// Received data held in online command mode, replayed on return
+FIFO spFIFO(SPILL_BITS);
 FIFO dyFIFO(4);
 
 
@@ -57,6 +62,11 @@ AFSK::~AFSK() {
 */
 void AFSK::init(AFSK_t afsk, CFG_t *conf) {
   cfg = conf;
+  // Use the stored sampling clock correction, if any
+  Profile profile;
+  int32_t fcor;
+  if (profile.corGet(&fcor))
+    fCor = fcor;
   // Hardware init
   this->initHW();
   // Set the modem type
@@ -77,22 +87,29 @@ void AFSK::setModemType(AFSK_t afsk) {
   cfgAFSK = afsk;
   // Compute the wave index steps
   this->initSteps();
+  // Compute the RX band-pass filters
+  this->initFilters();
+  // Scale the autocorrelation queues to the sampling frequency
+  this->initQueues();
   // Go offline, switch to command mode
   this->setLine(OFF);
   // Start as originating modem
   this->setDirection(ORIGINATING);
+#if AFSK_FIXED == 0
   // Compute modem specific parameters
   fulBit = F_SAMPLE / cfgAFSK.baud;
   hlfBit = fulBit >> 1;
   qrtBit = hlfBit >> 1;
   octBit = qrtBit >> 1;
+  dtBits = cfgAFSK.dtbits;
+#endif
   // Compute CarrierDetect threshold
   cdTotal = F_SAMPLE / 10 * cfg->sregs[9];
   cdTotal = cdTotal - (cdTotal >> 4);
 }
 
 /**
-  Compute the originating and answering samples steps, as Q8.8
+  Compute the originating and answering samples steps, as phase_t
 
   @param x the afsk modem to compute for
 */
@@ -103,6 +120,69 @@ void AFSK::initSteps() {
   cfgAFSK.answ.step[MARK]  = wave.getStep(cfgAFSK.answ.freq[MARK]);
 }
 
+/**
+  Compute the originating and answering band-pass filter coefficients,
+  as Q9.  Each filter is a Hamming windowed, linear phase FIR, centred
+  between the SPACE and MARK frequencies, with a bandwidth twice the
+  frequency shift, so the other band (our own TX carrier, in full duplex)
+  is rejected.  Being symmetric, only the first half is kept.
+
+  The nearest TX tone is rejected by about 40dB for Bell 103, but only
+  20dB for V.21 at 9600Hz (35dB at 7200Hz), its bands being closer.
+*/
+void AFSK::initFilters() {
+  AFSK_FSQ_t *fsq[] = {&cfgAFSK.orig, &cfgAFSK.answ};
+  for (uint8_t i = 0; i < 2; i++) {
+    // Centre frequency and bandwidth
+    float fc = (fsq[i]->freq[SPACE] + fsq[i]->freq[MARK]) / 2.0;
+    float bw = 2.0 * abs((int16_t)fsq[i]->freq[MARK] - (int16_t)fsq[i]->freq[SPACE]);
+    for (uint8_t k = 0; k <= BPF_TAPS / 2; k++) {
+      // Distance from the middle tap
+      int8_t n = k - BPF_TAPS / 2;
+      // Low-pass prototype, half the bandwidth
+      float h = (n == 0) ? bw / F_SAMPLE : sin(PI * bw * n / F_SAMPLE) / (PI * n);
+      // Hamming window
+      h *= 0.54 - 0.46 * cos(2.0 * PI * k / (BPF_TAPS - 1));
+      // Shift to the centre frequency
+      h *= 2.0 * cos(2.0 * PI * fc * n / F_SAMPLE);
+      fsq[i]->coef[k] = (int8_t)round(h * 512);
+    }
+  }
+#if ADC_OVS > 1
+  // The decimator low-pass filter, Hamming windowed, cut off at half
+  // F_SAMPLE, with unity gain (Q7)
+  const uint8_t n = ADC_OVS * OVS_TAPS;
+  float h[n];
+  float sum = 0;
+  for (uint8_t k = 0; k < n; k++) {
+    // Distance from the middle, half a sample off, as the length is even
+    float m = k - (n - 1) / 2.0;
+    h[k] = sin(PI * m / ADC_OVS) / (PI * m) * (0.54 - 0.46 * cos(2.0 * PI * k / (n - 1)));
+    sum += h[k];
+  }
+  for (uint8_t k = 0; k < n; k++)
+    ovs.coef[k] = (int8_t)round(h[k] / sum * 128);
+#endif
+}
+
+/**
+  Scale the originating and answering autocorrelation queue lengths,
+  given for 9600Hz, to F_SAMPLE, keeping the same delay, and find the
+  symbol polarity for the new delay: the demodulator output is
+  proportional to cos(2 * PI * freq * delay), HIGH meaning MARK, unless
+  reversed by the polarity.
+*/
+void AFSK::initQueues() {
+  AFSK_FSQ_t *fsq[] = {&cfgAFSK.orig, &cfgAFSK.answ};
+  for (uint8_t i = 0; i < 2; i++) {
+    // The queue length, rounded
+    fsq[i]->queuelen = ((uint32_t)fsq[i]->queuelen * F_SAMPLE + 4800) / 9600;
+    // Reverse the polarity if MARK gives the lower output
+    float t = TWO_PI * fsq[i]->queuelen / F_SAMPLE;
+    fsq[i]->polarity = cos(t * fsq[i]->freq[MARK]) < cos(t * fsq[i]->freq[SPACE]);
+  }
+}
+
 /**
   Initialize the hardware
 */
@@ -116,8 +196,8 @@ void AFSK::initHW() {
   // TC1 Control Register B: No prescaling, WGM mode 12
   TCCR1A = 0;
   TCCR1B = _BV(CS10) | _BV(WGM13) | _BV(WGM12);
-  // Top set for F_SAMPLE
-  ICR1 = ((F_CPU + F_COR) / F_SAMPLE) - 1;
+  // Top set for F_SAMPLE, times the ADC oversampling ratio
+  ICR1 = ((F_CPU + fCor) / ((uint32_t)F_SAMPLE * ADC_OVS)) - 1;
 
   // ADC Left Adjust Result
 #ifdef AREF_EXT
@@ -168,6 +248,16 @@ void AFSK::initHW() {
   // Configure ring trigger (2)
   DDRD  &= ~(_BV(PORTD2));
   PORTD |=   _BV(PORTD2);
+  // RING on INT0, falling edge
+  EICRA  = (EICRA & ~(_BV(ISC01) | _BV(ISC00))) | _BV(ISC01);
+  EIFR   = _BV(INTF0);
+  EIMSK |= _BV(INT0);
+  // DTR on PCINT20, any change
+  PCMSK2 |= _BV(PCINT20);
+  PCIFR   = _BV(PCIF2);
+  PCICR  |= _BV(PCIE2);
+  // The initial DTR level
+  dtrLow = not (PIND & _BV(PORTD4));
 
   // Set initial PWM to the first sample
   priDAC(wave.sample((uint8_t)0));
@@ -193,8 +283,6 @@ void AFSK::setLeds(uint8_t onoff) {
   Clear any ringing counters and signals.
 */
 void AFSK::clearRing() {
-  // Reset the signaling timeout
-  outRingTimeout = 0;
   // Reset the counter
   cfg->sregs[1] = 0;
   // Stop sending signal to RI
@@ -207,8 +295,25 @@ void AFSK::clearRing() {
 void AFSK::doTXRX() {
   //Disable interrupts
   cli();
+#if ADC_OVS > 1
+  // Decimate the input, go on only once for each output sample
+  if (not this->ovsHandle(ADCH))
+    return;
+  // Still handling the previous output sample: this one is lost, count it
+  if (ovs.busy) {
+    if (ovsLost < 0xFFFF)
+      ovsLost++;
+    return;
+  }
+  // Get the decimated sample first
+  rxSample = ovs.out;
+  // Let the next input samples come in meanwhile
+  ovs.busy = 1;
+  sei();
+#else
   // Get the sample first
   rxSample = ADCH;
+#endif
   if (this->onLine) {
     // Handle TX (constant delay)
     this->txHandle();
@@ -217,40 +322,76 @@ void AFSK::doTXRX() {
   }
   // Handle the audio monitor
   this->spkHandle();
+  // Debounce the RING and DTR inputs, only while they are changing
+  if (ring.edge or ring.state != RING_IDLE or dtrChg or dtrDbc != 0)
+    this->pinHandle();
+  // Detect the serial BREAK, only if enabled and in data mode
+  if (brkOn)
+    this->brkHandle();
+#ifdef DEBUG_CYCLES
+  // Timer1 counts CPU cycles from the start of the sample period
+  uint16_t cyc = TCNT1;
+  if (cyc > cycMax) cycMax = cyc;
+  cycSum += cyc;
+  cycCnt++;
+#endif
+#if ADC_OVS > 1
+  ovs.busy = 0;
+#endif
   // Enable interrupts
   sei();
 }
 
+#if ADC_OVS > 1
 /**
-  Send the sample to the primary DAC
+  Polyphase decimator.  Each input sample is added, weighted by the
+  coefficients of its phase, to the OVS_TAPS output samples it takes part
+  in (transposed form), so the work is evenly spread over the input
+  samples.  After the last input sample of the period, the current output
+  sample is complete.
+
+  @param sample the (unsigned) input sample
+  @return true if a new output sample is ready
+*/
+bool AFSK::ovsHandle(uint8_t sample) {
+  int8_t x = sample - 0x80;
+  // The coefficients of this phase, ADC_OVS apart
+  const int8_t *h = &ovs.coef[ADC_OVS - 1 - ovs.phase];
+  for (uint8_t k = 0; k < OVS_TAPS; k++)
+    ovs.acc[k] += mulS8(h[k * ADC_OVS], x);
+  // Check if this was the last input sample of the period
+  if (++ovs.phase < ADC_OVS)
+    return false;
+  ovs.phase = 0;
+  // The output sample, rounded and saturated
+  int16_t y = (ovs.acc[0] + 0x40) >> 7;
+  if      (y >  127) y =  127;
+  else if (y < -128) y = -128;
+  ovs.out = y + 0x80;
+  // Move on to the next output samples
+  for (uint8_t k = 0; k < OVS_TAPS - 1; k++)
+    ovs.acc[k] = ovs.acc[k + 1];
+  ovs.acc[OVS_TAPS - 1] = 0;
+  return true;
+}
+#endif
+
+/**
+  Send the sample to the primary DAC, the register selected by setLine
 
   @param sample the sample to output to DAC
 */
 inline void AFSK::priDAC(uint8_t sample) {
-  switch (selDAC) {
-    case 1:
-      OCR2B = sample;
-      break;
-    default:
-      OCR2A = sample;
-      break;
-  }
+  *priOCR = sample;
 }
 
 /**
-  Send the sample to the secondary DAC
+  Send the sample to the secondary DAC, the register selected by setLine
 
   @param sample the sample to output to DAC
 */
 inline void AFSK::secDAC(uint8_t sample) {
-  switch (selDAC) {
-    case 0:
-      OCR2B = sample;
-      break;
-    default:
-      OCR2A = sample;
-      break;
-  }
+  *secOCR = sample;
 }
 
 
@@ -262,15 +403,29 @@ inline void AFSK::secDAC(uint8_t sample) {
 void AFSK::txHandle() {
   // Check if we are transmitting
   if (tx.active == ON or tx.carrier == ON) {
-    // First thing first: get the sample, index is Q8.8
+    // First thing first: get the sample, the top byte of the phase
+#ifdef TX_NOISE_SHAPING
+    txSample = nsHandle(tx.idx);
+#else
     txSample = wave.sample(tx.idx);
+#endif
     // Output the sample
     priDAC(txSample);
     // Step up the index for the next sample
-    tx.idx += fsqTX->step[tx.dtbit];
+#if TX_RAMP > 0
+    // Move along the ramp towards the current data bit
+    if (tx.dtbit == MARK) {
+      if (tx.rmp < TX_RAMP) tx.rmp++;
+    }
+    else if (tx.rmp > 0)
+      tx.rmp--;
+    tx.idx += tx.ramp[tx.rmp];
+#else
+    tx.idx += tx.step[tx.dtbit];
+#endif
 
     // Check if we have sent all samples for a bit
-    if (tx.clk++ >= fulBit) {
+    if (++tx.clk >= fulBit) {
       // Reset the samples counter
       tx.clk = 0;
 
@@ -319,7 +474,7 @@ void AFSK::txHandle() {
         // We are sending the data bits, keep sending until the last
         case DATA_BIT:
           // Check if we have sent all the bits
-          if (++tx.bits < cfgAFSK.dtbits) {
+          if (++tx.bits < dtBits) {
             // Keep sending the data bits, LSB to MSB
             tx.dtbit  = tx.data & 0x01;
             tx.data   = tx.data >> 1;
@@ -405,6 +560,31 @@ void AFSK::txHandle() {
   }
 }
 
+
+#ifdef TX_NOISE_SHAPING
+/**
+  Noise shaping quantizer.  The fine, interpolated wave sample is
+  requantized to 8 bits for the PWM DAC with the error fed back through
+  1 - 2cos(w) z^-1 + z^-2, w being the RX band centre.  The quantization
+  noise is pushed away from our own RX band, where the echo of our
+  carrier lands, into the bands the RX filter rejects anyway.
+
+  @param idx the wave phase
+  @return the (unsigned) sample
+*/
+uint8_t AFSK::nsHandle(phase_t idx) {
+  // Subtract the filtered errors from the fine sample (Q8)
+  int16_t v = wave.sampleFine(idx) -
+              (((int32_t)tx.nsCoef * tx.nsErr[0]) >> 14) + tx.nsErr[1];
+  // Quantize, rounding to nearest
+  int8_t y = (v + 0x80) >> 8;
+  // Keep the quantization errors
+  tx.nsErr[1] = tx.nsErr[0];
+  tx.nsErr[0] = ((int16_t)y << 8) - v;
+  return y + 0x80;
+}
+#endif
+
 /**
   RX workhorse.  Called by ISR for each input sample, it autocorrelates
   the input samples for a delay queue tailored for MARK symbol,
@@ -414,10 +594,24 @@ void AFSK::txHandle() {
   @param sample the (unsigned) sample
 */
 void AFSK::rxHandle(uint8_t sample) {
-  // Create the signed sample
-  int8_t ss = sample - bias;
+  // Blank the impulse noise
+  sample = blkHandle(sample);
+  // Track the DC bias of the input, moving average over 256 samples
+  biasAcc = biasAcc - (biasAcc >> 8) + sample;
+  bias = biasAcc >> 8;
+  // Create the signed sample, saturated, as the bias is not always 0x80
+  int16_t sd = (int16_t)sample - bias;
+  if      (sd >  127) sd =  127;
+  else if (sd < -128) sd = -128;
+  // Cancel the echo of our own TX samples, keep only the receiving band
+  // and normalize its level
+#if EC_TAPS > 0
+  int8_t ss = agcHandle(bpfHandle(ecHandle((int8_t)sd)));
+#else
+  int8_t ss = agcHandle(bpfHandle((int8_t)sd));
+#endif
   // And the signed delayed sample
-  int8_t ds = dyFIFO.out() - bias;
+  int8_t ds = (int8_t)dyFIFO.out();
 
 #ifdef DEBUG_RX_LVL
   // Keep sample for level measurements
@@ -439,24 +633,202 @@ void AFSK::rxHandle(uint8_t sample) {
   //  1200:  0.4470595850866754  0.10588082982664918
 
   rx.iirX[0] = rx.iirX[1];
-  rx.iirX[1] = (ds * ss) >> 2;
+  rx.iirX[1] = mulS8(ds, ss) >> 2;
 
   rx.iirY[0] = rx.iirY[1];
   rx.iirY[1] = rx.iirX[0] + rx.iirX[1] + (rx.iirY[0] >> 1);
 
-  // Keep the unsigned sample in delay FIFO
-  dyFIFO.in(sample);
+  // Keep the filtered sample in delay FIFO
+  dyFIFO.in((uint8_t)ss);
+
+  // Average the discriminator output over the last 8 samples of the
+  // start and stop bits for the AFC, clear of the previous symbol
+  if ((rx.state == START_BIT or rx.state == STOP_BIT) and rx.clk >= fulBit - 8)
+    rx.afcAcc += rx.iirY[1] >> 3;
+
+  // Time the carrier periods for the sampling clock calibration, only
+  // while receiving MARK, at the rising zero crossings, with hysteresis
+  if (cal.active) {
+    if (rx.state == WAIT and rx.stream == 0xFF) {
+      cal.clk++;
+      if (cal.pos == OFF and ss > CAL_HYST) {
+        // A new period, count it if the previous one was timed too
+        if (cal.valid) {
+          cal.periods++;
+          cal.samples += cal.clk;
+        }
+        cal.valid = ON;
+        cal.pos   = ON;
+        cal.clk   = 0;
+      }
+      else if (ss < -CAL_HYST)
+        cal.pos = OFF;
+    }
+    else
+      // Start over at the next rising zero crossing
+      cal.valid = OFF;
+  }
 
   // TODO Validate the RX tones
   rx.active = true; //abs(rx.iirY[1] > 1);
   if (rx.active)
-    // Call the decoder
-    rxDecoder(((rx.iirY[1] > 0) ? MARK : SPACE) ^ fsqRX->polarity);
+    // Call the decoder, slicing at the AFC threshold
+    rxDecoder(((rx.iirY[1] > rx.afcThr) ? MARK : SPACE) ^ rx.polarity);
   else
     // Disable the decoder and wait
     rx.state  = WAIT;
 }
 
+/**
+  Impulse noise blanker.  Line clicks saturate the ADC for a few samples
+  and, left alone, ring through the filters for whole bits.  A sample
+  deviating from the DC bias more than twice the peak level of the last
+  256 samples is an impulse: it is replaced, along with the next
+  BLK_HOLD - 1 samples, by the DC bias, which is silence downstream.
+  The peak level may at most double for each 256 samples, so the
+  threshold follows a rising line level, while a single click cannot
+  raise it too much.
+
+  @param sample the (unsigned) sample
+  @return the sample, or the DC bias if blanked
+*/
+uint8_t AFSK::blkHandle(uint8_t sample) {
+  // The deviation from the DC bias
+  uint8_t a = abs((int16_t)sample - bias);
+  // Keep the peak level, limited to the threshold
+  if (a > rx.blkPeak) rx.blkPeak = min(a, rx.blkLim);
+  // Adjust the threshold each 256 samples
+  if (++rx.blkCnt == 0) {
+    rx.blkLim = constrain(rx.blkPeak << 1, BLK_MIN, BLK_MAX);
+    rx.blkPeak = 0;
+  }
+  // Check for impulses
+  if (a > rx.blkLim)
+    rx.blkHold = BLK_HOLD;
+  // Blank the samples
+  if (rx.blkHold != 0) {
+    rx.blkHold--;
+    blanked++;
+    sample = bias;
+  }
+  return sample;
+}
+
+/**
+  RX band-pass pre-filter.  Linear phase FIR filter tuned on the receiving
+  band, selected by setDirection, which rejects the local echo of our own
+  TX carrier before the delay-multiply demodulator.  The filter being
+  symmetric, the samples sharing a coefficient are added first, so it
+  takes BPF_TAPS / 2 + 1 multiplications per sample.
+
+  @param sample the signed sample
+  @return the filtered signed sample (Q4)
+*/
+int16_t AFSK::bpfHandle(int8_t sample) {
+  // Keep the sample in the circular delay line
+  rx.bpfX[rx.bpfIdx] = sample;
+  // The newest and the oldest samples
+  uint8_t i = rx.bpfIdx;
+  uint8_t j = rx.bpfIdx - (BPF_TAPS - 1);
+  int32_t acc = 0;
+  for (uint8_t k = 0; k < BPF_TAPS / 2; k++)
+    acc = macS16S8(acc, rx.bpfX[i-- & BPF_MASK] + rx.bpfX[j++ & BPF_MASK], fsqRX->coef[k]);
+  // The middle tap
+  acc += mulS8(rx.bpfX[i & BPF_MASK], fsqRX->coef[BPF_TAPS / 2]);
+  // Step up the delay line index
+  rx.bpfIdx = (rx.bpfIdx + 1) & BPF_MASK;
+  // Keep four fractional bits for the AGC
+  return acc >> 5;
+}
+
+/**
+  Automatic gain control.  Keep the peak level of the filtered samples
+  and, every 256 samples (8 bits), adjust the gain to bring that peak
+  to AGC_TARGET, so the 8 bits products in the correlator neither clip
+  nor lose resolution, whatever the line level.
+
+  @param sample the filtered signed sample (Q4)
+  @return the normalized signed sample
+*/
+int8_t AFSK::agcHandle(int16_t sample) {
+  // Keep the peak level
+  uint16_t a = abs(sample);
+  if (a > rx.agcPeak) rx.agcPeak = a;
+  // Adjust the gain each 256 samples
+  if (++rx.agcCnt == 0) {
+    // The line level, in ADC units
+    level = rx.agcPeak >> 4;
+    // The gain which would bring the peak to target, limited
+    uint16_t g = AGC_MAXGAIN;
+    if (rx.agcPeak > ((uint32_t)AGC_TARGET << 12) / AGC_MAXGAIN)
+      g = ((uint32_t)AGC_TARGET << 12) / rx.agcPeak;
+    // Smooth the gain changes
+    gain = (uint16_t)(((uint32_t)gain * 3 + g) >> 2);
+    rx.agcPeak = 0;
+  }
+  // Apply the gain, saturated
+  int16_t y = ((int32_t)sample * gain) >> 12;
+  if      (y >  127) y =  127;
+  else if (y < -128) y = -128;
+  return (int8_t)y;
+}
+
+#if EC_TAPS > 0
+/**
+  Adaptive echo canceller.  We know exactly what we transmit, so an FIR
+  filter fed with the last EC_TAPS TX samples estimates the echo coming
+  back through the hybrid, which is then subtracted from the RX sample.
+  The weights are adapted with LMS on the residual, only while
+  transmitting and unless the Geigel detector reports double-talk: the
+  RX sample exceeds half the recent TX peak, more than the echo through
+  the hybrid, so the far end must be talking too.
+
+  Cost on AVR, from the instruction counts, with the kernels in dsp.h:
+  about 30 cycles per tap for the estimation and 20 more for the
+  adaptation, that is nearly 400 cycles per sample with 8 taps, out of
+  the 1666 available at 9600 Hz.  Use DEBUG_CYCLES to measure the actual
+  doTXRX load.
+
+  @param sample the signed RX sample
+  @return the signed sample, with the echo removed
+*/
+int8_t AFSK::ecHandle(int8_t sample) {
+  int32_t acc = 0;
+  uint8_t peak = 0;
+  // Transmitting, as in txHandle
+  bool txOn = tx.active == ON or tx.carrier == ON;
+  // Estimate the echo, starting with the newest TX sample
+  uint8_t i = ec.idx;
+  for (uint8_t k = 0; k < EC_TAPS; k++) {
+    int8_t x = ec.x[i-- & EC_MASK];
+    acc = macS16S8(acc, ec.w[k], x);
+    // Keep the TX peak for the double-talk detector
+    if (x < 0) x = -x;
+    if ((uint8_t)x > peak) peak = x;
+  }
+  // Remove the echo, saturated
+  int16_t e = sample - (int16_t)(acc >> 14);
+  if      (e >  127) e =  127;
+  else if (e < -128) e = -128;
+  // Geigel double-talk detector, with hangover
+  if ((uint8_t)abs(sample) > (peak >> EC_DTD))
+    ec.hold = EC_HOLD;
+  else if (ec.hold > 0)
+    ec.hold--;
+  // Adapt the weights, only if transmitting and not in double-talk
+  if (ec.hold == 0 and txOn and peak != 0) {
+    i = ec.idx;
+    for (uint8_t k = 0; k < EC_TAPS; k++)
+      ec.w[k] += (mulS8(e, ec.x[i-- & EC_MASK]) + (1 << (EC_MU - 1))) >> EC_MU;
+  }
+  // Keep the current TX sample, its echo will come with the next samples;
+  // silence if not transmitting, the last sample is stale
+  ec.idx = (ec.idx + 1) & EC_MASK;
+  ec.x[ec.idx] = txOn ? txSample - 0x80 : 0;
+  return (int8_t)e;
+}
+#endif
+
 /**
   The RX data decoder.  Receive the decoded data bit and try
   to figure out the entire received byte.
@@ -531,14 +903,17 @@ void AFSK::rxDecoder(uint8_t bt) {
     case PREAMBLE:
       // Check if we have collected enough samples
       if (rx.clk >= hlfBit) {
-        // Check the average level of decoded samples: less than a quarter
-        // of them may be HIGHs; the bitsum must be lesser than octBit
-        if (rx.bitsum > octBit)
+        // Check the average level of decoded samples: less than half
+        // of them may be HIGHs, as the delay queue smears the transition;
+        // the bitsum must be lesser than qrtBit
+        if (rx.bitsum > qrtBit)
           // Too many HIGH, this is not a start bit
           rx.state  = WAIT;
-        else
+        else {
           // Could be a start bit, keep on going and check again at the end
           rx.state  = START_BIT;
+          rx.afcAcc = 0;
+        }
       }
       break;
 
@@ -562,7 +937,9 @@ void AFSK::rxDecoder(uint8_t bt) {
               rx.state  = WAIT;
             }
             else {
-              // This is a start bit, go on to data bits
+              // This is a start bit, keep its level for AFC
+              rx.afcNew = rx.afcAcc;
+              // Go on to data bits
               rx.state  = DATA_BIT;
               rx.data   = 0;
               rx.clk    = 0;
@@ -586,7 +963,7 @@ void AFSK::rxDecoder(uint8_t bt) {
             rxFIFO.in((rx.bitsum >> 2) + 'A');
 #endif
             // Check if we are still receiving the data bits
-            if (++rx.bits < cfgAFSK.dtbits) {
+            if (++rx.bits < dtBits) {
               // Prepare for a new bit: reset the clock and the bitsum
               rx.clk    = 0;
               rx.bitsum = 0;
@@ -596,6 +973,7 @@ void AFSK::rxDecoder(uint8_t bt) {
               rx.state  = STOP_BIT;
               rx.clk    = hlfBit;
               rx.bitsum = 0;
+              rx.afcAcc = 0;
             }
             break;
 
@@ -609,9 +987,16 @@ void AFSK::rxDecoder(uint8_t bt) {
             // Check the average level of decoded samples: at least half
             // of them must be HIGH, the bitsum must be more than qrtBit
             // (remember we have only the first half of the stop bit)
-            if (rx.bitsum > qrtBit)
-              // Push the data into FIFO
-              rxFIFO.in(rx.data);
+            if (rx.bitsum > qrtBit) {
+              // Push the data into FIFO, count it if lost
+              if (not rxFIFO.in(rx.data) and rxLost < 0xFFFF)
+                rxLost++;
+              // Both the start and the stop bits are known, move the
+              // average levels towards them and slice at the midpoint
+              rx.afcSpc += (rx.afcNew - rx.afcSpc) >> AFC_RATE;
+              rx.afcMrk += (rx.afcAcc - rx.afcMrk) >> AFC_RATE;
+              rx.afcThr  = (rx.afcSpc + rx.afcMrk) >> 1;
+            }
 #ifdef DEBUG_RX
             rxFIFO.in(10);
 #endif
@@ -626,132 +1011,87 @@ void AFSK::rxDecoder(uint8_t bt) {
 }
 
 /**
-  Check the serial I/O and transmit the data, respectively check
-  the received data and send it to the serial port.
+  Check if there are serial I/O events to report: the end of dialing,
+  the carrier detection, the end of the calibration or the loss of the
+  RX carrier
+
+  @return true if doEvents has something to do
 */
-uint8_t AFSK::doSIO() {
-  // The charcter on the serial line
-  uint8_t c;
-  // The result (if unchanged, it's command mode, hayes will process)
-  uint8_t result = 255;
-  // The escape characters counters
-  static uint8_t  escCount = 0;
-  static uint32_t escFirst = 0;
-  static uint32_t escLast  = 0;
-  static uint32_t lstChar  = 0;
-  static uint32_t now      = 0;
+bool AFSK::hasEvents() {
+  return this->cdPending == ON or this->dlPending == ON or this->calPending == ON or
+         rx.state == NO_CARRIER or brkSeen == ON;
+}
+
+/**
+  Report the serial I/O events: the end of dialing, the carrier
+  detection, the end of the calibration or the loss of the RX carrier
+
+  @return the event or the result code, SIO_NONE if nothing to report
+*/
+uint8_t AFSK::doEvents() {
   // Characters waiting on the serial input
   bool inAvlb = (Serial.available() != 0);
 
-  // The time
-  now = millis();
-
-  // Check the RING input, only when offline, 10 times per second
-  if (this->onLine == OFF and this->opMode == COMMAND_MODE and
-      (now >= inpRingTimeout or inpRingTimeout == 0)) {
-    inpRingTimeout = now + 100UL;
-    // Check if ringing
-    if (not (PIND & _BV(PORTD2))) {
-      // Ringing
-      if (now > outRingTimeout or outRingTimeout == 0) {
-        // Update the timeout
-        outRingTimeout = now + 2000UL;
-        // Send signal to RI
-        PORTB |= _BV(PORTB5);
-        // Increment the counter
-        cfg->sregs[1] += 1;
-        // RC_RING
-        result = 2;
-      }
+  // Check the carrier detection, the RX decoder validates it
+  if (this->cdPending == ON) {
+    if (rx.carrier == ON) {
+      // Carrier detected
+      this->cdPending = OFF;
+      return SIO_CD_ON;
     }
-    else if (cfg->sregs[1] != 0) {
-      // No ringing, but the counter is not zero, so it was
-      // ringing and stopped; clear everything
-      this->clearRing();
+    else if (inAvlb or millis() > cdTOut) {
+      // Stop checking if there is any char on serial or timed out,
+      // no RX if carrier not detected
+      rx.state = NOP;
+      this->cdPending = OFF;
+      return SIO_CD_OFF;
     }
-    if (result != 255)
-      return result;
+    // Still waiting, nothing else to do
+    return SIO_NONE;
   }
 
-  // Check if we saw the escape string "+++"
-  if (escCount == 3) {
-    // We did, we did taw the escape string!
-    // Check for the guard silence (S12)
-    if (now - escLast > escGuard) {
-      // This is it, go in command mode
-      escCount = 0;
-      this->setMode(COMMAND_MODE);
-      // RC_OK
-      result = 0;
+  // Check the dialing, the ISR stops it at the end of the number
+  if (this->dlPending == ON) {
+    if (inAvlb) {
+      // Stop dialing if there is any char on serial
+      this->isDialing = OFF;
+      this->dlPending = OFF;
+      return SIO_DIAL_ABORT;
     }
-    else if (inAvlb) {
-      // We just saw the full string (still in after guard time),
-      // and there is something more on the line
-      c = Serial.peek();
-      if (c == '\r' or c == '\n')
-        // Ignore CR and LF.
-        Serial.read();
-      else {
-        // There is something else, transmit the escape string
-        // to the other part and stay in data mode
-        for (uint8_t i = escCount; i > 0; i--) {
-          // Send the chars
-          txFIFO.in(escChar);
-          // Local datamode echo only on half duplex
-          if (cfg->dtecho == OFF)
-            Serial.write(escChar);
-        }
-        // Reset the counter and the first mark
-        escCount = 0;
-        escFirst = 0;
-        lstChar  = now;
-      }
+    else if (this->isDialing == OFF) {
+      // Dialing is over
+      this->dlPending = OFF;
+      return SIO_DIAL_DONE;
     }
+    // Still dialing, nothing else to do
+    return SIO_NONE;
   }
-  else if (escCount > 0) {
-    // There were at most two escape chars, check if it took too long
-    if (now - escFirst > escGuard) {
-      // No more '+' chars and timed out
-      for (uint8_t i = escCount; i > 0; i--) {
-        // Send the chars
-        txFIFO.in(escChar);
-        // Local datamode echo only on half duplex
-        if (cfg->dtecho == OFF)
-          Serial.write(escChar);
-      }
-      // Reset the counter
-      escCount = 0;
-      escFirst = 0;
-      lstChar  = now;
+
+  // Check the sampling clock calibration
+  if (this->calPending == ON) {
+    if (inAvlb or rx.carrier == OFF) {
+      // Stop measuring if there is any char on serial or no more carrier
+      cal.active = OFF;
+      this->calPending = OFF;
+      return SIO_CAL_ABORT;
     }
+    else if (millis() > calTOut) {
+      // Measured for the whole time
+      this->calPending = OFF;
+      return SIO_CAL_DONE;
+    }
+    // Still measuring, nothing else to do
+    return SIO_NONE;
   }
 
-  // Check if there is any data on serial port
-  if (inAvlb) {
-    // Check for "+++" escape sequence (S2)
-    if (Serial.peek() == escChar) {
-      // Check when we saw the first '+' (S12)
-      if (now - escFirst > escGuard) {
-        // The first is older than the guard time, this may be a new first,
-        // so check the before guard time too
-        if (now - lstChar >= escGuard) {
-          // This is the first, the last char was long ago, keep the time
-          escCount = 1;
-          escFirst = now;
-          // Remove it from the buffer and make it unavailable
-          Serial.read();
-          inAvlb = false;
-        }
-      }
-      else {
-        // The last '+' was seen recently, count them up until three.
-        // If this is the last, keep the time and wait for the guard silence
-        if (++escCount == 3)
-          escLast = now;
-        // Remove it from the buffer and make it unavailable
-        Serial.read();
-        inAvlb = false;
-      }
+  // Check the serial BREAK, go in command mode
+  if (brkSeen == ON) {
+    brkSeen = OFF;
+    if (this->opMode == DATA_MODE) {
+      escCount = 0;
+      this->setMode(COMMAND_MODE);
+      // RC_OK
+      return 0;
     }
   }
 
@@ -762,115 +1102,515 @@ uint8_t AFSK::doSIO() {
     // Go in command mode
     this->setMode(COMMAND_MODE);
     // RC_NO_CARRIER
-    result = 3;
+    return 3;
   }
 
-  // Only in data mode
-  if (this->opMode != COMMAND_MODE) {
-    // Data mode, say to hayes we have processed the data
-    result = 254;
-
-    // Check DTR and act accordingly
-    if (cfg->dtropt > 0) {
-      // Check DTR
-      if (not (PIND & _BV(PORTD4))) {
-        // DTR low
-        switch (cfg->dtropt) {
-          case 1: // Return to command mode
-            // Go in command mode
-            this->setMode(COMMAND_MODE);
-            // RC_OK
-            result = 0;
-            break;
-          case 2: // Hang up, turn off auto answer, return to command mode
-            // No auto-answer
-            cfg->sregs[0] = 0;
-            // Go offline and command mode
-            this->setLine(OFF);
-            // RC_NO_CARRIER
-            result = 3;
-            break;
-          case 3: // Reset
-            wdt_enable(WDTO_250MS);
-            while (true) {};
-            break;
-        }
-      }
+  // Nothing to report
+  return SIO_NONE;
+}
+
+/**
+  RING input falling edge (INT0): just mark it, the sample ISR handles it
+*/
+void AFSK::ringEdge() {
+  ring.edge = ON;
+}
+
+/**
+  DTR input change (PCINT20): just mark it, the sample ISR handles it
+*/
+void AFSK::dtrEdge() {
+  dtrChg = ON;
+}
+
+/**
+  Debounce the RING and DTR inputs and run the ring cadence detector,
+  for each sample, only while the inputs are changing
+*/
+void AFSK::pinHandle() {
+  // DTR changed, restart the debounce time
+  if (dtrChg == ON) {
+    dtrChg = OFF;
+    dtrDbc = DTR_DEBOUNCE;
+  }
+  // DTR is stable after the debounce time
+  else if (dtrDbc != 0 and --dtrDbc == 0)
+    dtrLow = not (PIND & _BV(PORTD4));
+  // RING falling edge, start a ring burst or keep it active
+  if (ring.edge == ON) {
+    ring.edge = OFF;
+    if (ring.state != RING_ON) {
+      // A new ring, unless this burst follows the last one too closely
+      if (ring.state == RING_IDLE or ring.ticks >= RING_PAUSE)
+        ring.valid = OFF;
+      ring.state = RING_ON;
+      ring.ticks = 0;
+      ring.sub   = 0;
+    }
+    ring.hold = RING_HOLD;
+  }
+  // The ring cadence detector works in ticks
+  if (ring.state == RING_IDLE or ++ring.sub < RING_TICK)
+    return;
+  ring.sub = 0;
+  if (ring.ticks < 0xFFFF)
+    ring.ticks++;
+  if (ring.state == RING_ON) {
+    // Check the input, stay active while low and for the hold time
+    if (not (PIND & _BV(PORTD2)))
+      ring.hold = RING_HOLD;
+    else if (--ring.hold == 0) {
+      // The burst is over
+      ring.state = RING_OFF;
+      ring.ticks = 0;
+      return;
     }
+    if (ring.valid == OFF and ring.ticks >= RING_ON_MIN) {
+      // Long enough to be a ring, count it
+      ring.valid = ON;
+      ring.news++;
+    }
+    else if (ring.ticks == RING_ON_MAX) {
+      // Too long, this is not ringing, end the series
+      ring.over = ON;
+    }
+  }
+  else if (ring.ticks >= RING_OFF_MAX) {
+    // No more rings, the series is over
+    ring.state = RING_IDLE;
+    ring.over  = ON;
+  }
+}
 
-    // Flow control for outgoing (to DTE)
-    switch (cfg->flwctr) {
-      case FC_XONXOFF:
-        // Check if the next character is a XON/XOFF flow control,
-        // only if flow control is enabled
-        c = Serial.peek();
-        if (c == 0x13) {
-          // XOFF
-          Serial.read();
-          outFlow = true;
-        }
-        else if (c == 0x10) {
-          // XON
-          Serial.read();
-          outFlow = false;
-        };
-        break;
-      case FC_RTSCTS:
-        // RTS/CTS flow control
-        outFlow = (cfg->rtsopt == 0) and (not (PIND & _BV(PORTD6)));
+/**
+  Detect the serial BREAK: the RX input low for more than any char
+*/
+void AFSK::brkHandle() {
+  if (PIND & _BV(PORTD0))
+    brkCnt = 0;
+  else if (brkCnt < BRK_TIME and ++brkCnt == BRK_TIME)
+    brkSeen = ON;
+}
+
+/**
+  Check if the ring cadence detector has anything to report
+
+  @return true if doRing has something to do
+*/
+bool AFSK::hasRing() {
+  return ring.news != 0 or ring.over == ON;
+}
+
+/**
+  Report the rings counted by the cadence detector, only when offline,
+  and clear the ring counter at the end of the series
+
+  @return RC_RING if ringing, SIO_NONE otherwise
+*/
+uint8_t AFSK::doRing() {
+  // The ring series is over
+  if (ring.over == ON) {
+    ring.over = OFF;
+    this->clearRing();
+  }
+  // No new rings
+  if (ring.news == 0)
+    return SIO_NONE;
+  cli();
+  ring.news--;
+  sei();
+  // Only offline, in command mode and not waiting for anything
+  if (this->onLine == ON or this->opMode != COMMAND_MODE or
+      this->dlPending == ON or this->cdPending == ON)
+    return SIO_NONE;
+  // Send signal to RI
+  PORTB |= _BV(PORTB5);
+  // Increment the counter
+  cfg->sregs[1] += 1;
+  // RC_RING
+  return 2;
+}
+
+/**
+  Check the escape guard times: after "+++" and the guard silence go
+  in command mode, while fewer escape chars that took too long are
+  sent as data
+
+  @return RC_OK if the escape sequence is complete, SIO_NONE otherwise
+*/
+uint8_t AFSK::doEscape() {
+  // Only in data mode, only if we saw any escape char
+  if (this->opMode == COMMAND_MODE or escCount == 0)
+    return SIO_NONE;
+  // The time
+  uint32_t now = millis();
+  // TIES, there is no guard time: the escape chars are data, unless
+  // "AT" follows them soon enough
+  if (escOpt & ESC_TIES) {
+    if (now - escLast > escGuard)
+      this->escFlush(now);
+    return SIO_NONE;
+  }
+  // Check if we saw the escape string "+++"
+  if (escCount == 3) {
+    // We did, we did taw the escape string!
+    // Check for the guard silence (S12)
+    if (now - escLast > escGuard) {
+      // This is it, go in command mode
+      escCount = 0;
+      this->setMode(COMMAND_MODE);
+      // RC_OK
+      return 0;
+    }
+  }
+  else if (now - escFirst > escGuard) {
+    // There were at most two escape chars and it took too long
+    this->escFlush(now);
+  }
+  return SIO_NONE;
+}
+
+/**
+  Send the escape chars seen so far as data, reset the counter
+
+  @param now the current time
+*/
+void AFSK::escFlush(uint32_t now) {
+  for (uint8_t i = 0; i < escCount; i++) {
+    // The escape chars, then the 'A' of TIES
+    char c = i < 3 ? escChar : escA;
+    // Send the chars
+    txFIFO.in(c);
+    // Local datamode echo only on half duplex
+    if (cfg->dtecho == OFF)
+      Serial.write(c);
+  }
+  // Reset the counter and the first mark
+  escCount = 0;
+  escFirst = 0;
+  lstChar  = now;
+}
+
+/**
+  Check if DTR is low in data mode, and not ignored
+
+  @return true if doDTR has something to do
+*/
+bool AFSK::hasDTR() {
+  return this->opMode != COMMAND_MODE and cfg->dtropt > 0 and dtrLow == ON;
+}
+
+/**
+  Act on DTR low, in data mode
+
+  @return the result code, SIO_NONE if nothing to report
+*/
+uint8_t AFSK::doDTR() {
+  // Only in data mode, only if DTR is not ignored
+  if (this->opMode == COMMAND_MODE or cfg->dtropt == 0)
+    return SIO_NONE;
+  // Check DTR
+  if (dtrLow == ON) {
+    // DTR low
+    switch (cfg->dtropt) {
+      case 1: // Return to command mode
+        // Go in command mode
+        this->setMode(COMMAND_MODE);
+        // RC_OK
+        return 0;
+      case 2: // Hang up, turn off auto answer, return to command mode
+        // No auto-answer
+        cfg->sregs[0] = 0;
+        // Go offline and command mode
+        this->setLine(OFF);
+        // RC_NO_CARRIER
+        return 3;
+      case 3: // Reset
+        wdt_enable(WDTO_250MS);
+        while (true) {};
         break;
     }
+  }
+  return SIO_NONE;
+}
+
+/**
+  Update the hardware flow control: follow RTS for the outgoing data
+  and resume the incoming data when the TX FIFO has drained
+*/
+void AFSK::doFlow() {
+  // Only in data mode
+  if (this->opMode == COMMAND_MODE)
+    return;
+  // RTS/CTS flow control for outgoing (to DTE)
+  if (cfg->flwctr == FC_RTSCTS)
+    outFlow = (cfg->rtsopt == 0) and (not (PIND & _BV(PORTD6)));
+  // Try to disable flow control, if we can
+  if (inFlow and txFIFO.len() < fifoLow) {
+    if (cfg->flwctr == FC_XONXOFF)
+      // XON/XOFF flow control: XON
+      Serial.write(0x11);
+    else if (cfg->flwctr == FC_RTSCTS)
+      // RTS/CTS flow control
+      PORTD |= _BV(PORTD7);
+    // Resume flow
+    inFlow = false;
+  }
+}
+
+/**
+  Check if there is data to move, in data mode: chars on the serial
+  input we can take, or received bytes we can send to the serial port.
+  With the TX FIFO getting full, the serial input only matters if the
+  flow is to be stopped; without flow control (&K0) it waits for the
+  FIFO to drain, instead of spinning.
+
+  @return true if doData has something to do
+*/
+bool AFSK::hasData() {
+  if (this->opMode == COMMAND_MODE)
+    return false;
+  bool inReady = txFIFO.len() < fifoHgh ?
+                 (txFIFO.len() < fifoMed or (not inFlow)) :
+                 ((not inFlow) and cfg->flwctr != FC_NONE);
+  return (Serial.available() and inReady) or
+         (((not rxFIFO.empty()) or (not spFIFO.empty())) and (not outFlow));
+}
+
+/**
+  Check the serial input and transmit the data, respectively send
+  the received data to the serial port, in data mode
 
-    // Check if the FIFO
-    if (txFIFO.len() < fifoHgh) {
-      // The FIFO is not getting full, so check if we can take the byte
-      if (inAvlb and (txFIFO.len() < fifoMed or (not inFlow))) {
-        // There is data on serial port, process it normally
-        c = Serial.read();
-        if (txFIFO.in(c))
-          // Local datamode echo only on half duplex
-          if (cfg->dtecho == OFF)
-            Serial.write((char)c);
-        // Keep the time
-        lstChar = now;
-        // Keep transmitting
-        tx.active = ON;
+  @return RC_OK if the escape sequence is complete, SIO_NONE otherwise
+*/
+uint8_t AFSK::doData() {
+  // The charcter on the serial line
+  uint8_t c;
+  // Check the guard time first, the next char may end it
+  uint8_t result = this->doEscape();
+  if (result != SIO_NONE or this->opMode == COMMAND_MODE)
+    return result;
+  // Characters waiting on the serial input
+  bool inAvlb = (Serial.available() != 0);
+  // The time
+  uint32_t now = millis();
+
+  // TIES escape sequence, "+++AT" with no guard time (S13)
+  if (inAvlb and (escOpt & (ESC_TIES | ESC_NONE)) == ESC_TIES) {
+    c = Serial.peek();
+    if (escCount < 3 and c == escChar) {
+      // One more escape char
+      escCount++;
+      escLast = now;
+      Serial.read();
+      inAvlb = false;
+    }
+    else if (escCount == 3 and toupper(c) == 'A') {
+      // The 'A', keep it as received
+      escA = c;
+      escCount++;
+      escLast = now;
+      Serial.read();
+      inAvlb = false;
+    }
+    else if (escCount == 4 and toupper(c) == 'T') {
+      // This is it, go in command mode, the command line follows
+      Serial.read();
+      escCount = 0;
+      this->setMode(COMMAND_MODE);
+      return SIO_ESC_AT;
+    }
+    else if (escCount > 0)
+      // Not an escape sequence, send it
+      this->escFlush(now);
+  }
+  // We just saw the full string (still in after guard time),
+  // check if there is something more on the line
+  else if (escCount == 3 and inAvlb) {
+    c = Serial.peek();
+    if (c == '\r' or c == '\n') {
+      // Ignore CR and LF.
+      Serial.read();
+      inAvlb = false;
+    }
+    else
+      // There is something else, transmit the escape string
+      // to the other part and stay in data mode
+      this->escFlush(now);
+  }
+
+  // Check for "+++" escape sequence (S2)
+  if (inAvlb and (not (escOpt & (ESC_TIES | ESC_NONE))) and Serial.peek() == escChar) {
+    // Check when we saw the first '+' (S12)
+    if (now - escFirst > escGuard) {
+      // The first is older than the guard time, this may be a new first,
+      // so check the before guard time too
+      if (now - lstChar >= escGuard) {
+        // This is the first, the last char was long ago, keep the time
+        escCount = 1;
+        escFirst = now;
+        // Remove it from the buffer and make it unavailable
+        Serial.read();
+        inAvlb = false;
       }
     }
-    else if (not inFlow and cfg->flwctr != FC_NONE) {
-      // FIFO is getting full, check the flow control
-      if (cfg->flwctr == FC_XONXOFF)
-        // XON/XOFF flow control: XOFF
-        Serial.write(0x13);
-      else if (cfg->flwctr == FC_RTSCTS)
-        // RTS/CTS flow control
-        PORTD &= ~_BV(PORTD7);
-      // Stop flow
-      inFlow = true;
+    else {
+      // The last '+' was seen recently, count them up until three.
+      // If this is the last, keep the time and wait for the guard silence
+      if (++escCount == 3)
+        escLast = now;
+      // Remove it from the buffer and make it unavailable
+      Serial.read();
+      inAvlb = false;
     }
+  }
 
-    // Anytime, try to disable flow control, if we can
-    if (inFlow and txFIFO.len() < fifoLow) {
-      if (cfg->flwctr == FC_XONXOFF)
-        // XON/XOFF flow control: XON
-        Serial.write(0x11);
-      else if (cfg->flwctr == FC_RTSCTS)
-        // RTS/CTS flow control
-        PORTD |= _BV(PORTD7);
-      // Resume flow
-      inFlow = false;
+  // Check if the next character is a XON/XOFF flow control
+  if (inAvlb and cfg->flwctr == FC_XONXOFF) {
+    c = Serial.peek();
+    if (c == 0x13) {
+      // XOFF
+      Serial.read();
+      outFlow = true;
+      inAvlb = false;
     }
+    else if (c == 0x10) {
+      // XON
+      Serial.read();
+      outFlow = false;
+      inAvlb = false;
+    };
+  }
 
-    // Check if there is any data in RX FIFO
-    if ((not rxFIFO.empty()) and (not outFlow)) {
-      // Get the byte and send it to serial line
-      c = rxFIFO.out();
-      Serial.write(c);
+  // Check if the FIFO
+  if (txFIFO.len() < fifoHgh) {
+    // The FIFO is not getting full, so check if we can take the byte
+    if (inAvlb and (txFIFO.len() < fifoMed or (not inFlow))) {
+      // There is data on serial port, process it normally
+      c = Serial.read();
+      // A NUL while the RX input is still low is the start of a BREAK
+      if (c == 0 and brkOn and not (PIND & _BV(PORTD0)))
+        ;
+      else if (txFIFO.in(c))
+        // Local datamode echo only on half duplex
+        if (cfg->dtecho == OFF)
+          Serial.write((char)c);
+      // Keep the time
+      lstChar = now;
+      // Keep transmitting
+      tx.active = ON;
     }
   }
+  else if (not inFlow and cfg->flwctr != FC_NONE) {
+    // FIFO is getting full, check the flow control
+    if (cfg->flwctr == FC_XONXOFF)
+      // XON/XOFF flow control: XOFF
+      Serial.write(0x13);
+    else if (cfg->flwctr == FC_RTSCTS)
+      // RTS/CTS flow control
+      PORTD &= ~_BV(PORTD7);
+    // Stop flow
+    inFlow = true;
+  }
 
-  // Return the result (for hayes.doSIO, to print it)
-  return result;
+  // Check if there is any data held in command mode, replay it first
+  if ((not spFIFO.empty()) and (not outFlow)) {
+    // Get the byte and send it to serial line
+    c = spFIFO.out();
+    Serial.write(c);
+  }
+  // Check if there is any data in RX FIFO
+  else if ((not rxFIFO.empty()) and (not outFlow)) {
+    // Get the byte and send it to serial line
+    c = rxFIFO.out();
+    Serial.write(c);
+  }
+
+  return SIO_NONE;
+}
+
+/**
+  Check if there is received data to hold: online, in command mode, or
+  in data mode while the held data is replayed, to keep the order.
+  When the spill buffer is full, the data stays in RX FIFO.
+
+  @return true if doSpill has something to do
+*/
+bool AFSK::hasSpill() {
+  return this->onLine == ON and (not rxFIFO.empty()) and (not spFIFO.full()) and
+         (this->opMode == COMMAND_MODE or (not spFIFO.empty()));
+}
+
+/**
+  Hold the received data while in online command mode
+*/
+void AFSK::doSpill() {
+  while ((not rxFIFO.empty()) and (not spFIFO.full()))
+    spFIFO.in(rxFIFO.out());
+}
+
+/**
+  Get the count of bytes held in online command mode
+
+  @return the count of bytes held
+*/
+uint8_t AFSK::spillLen() {
+  return spFIFO.len();
+}
+
+/**
+  Check if there is a command line char to process: in command mode,
+  not dialing or waiting for the carrier
+
+  @return true if hayes.doSIO has something to do
+*/
+bool AFSK::hasCommand() {
+  return this->opMode == COMMAND_MODE and this->dlPending == OFF and
+         this->cdPending == OFF and this->calPending == OFF and Serial.available();
+}
+
+/**
+  Check if the modem is idle: offline, in command mode, not dialing,
+  not waiting for the carrier and not ringing
+
+  @return true if idle
+*/
+bool AFSK::isIdle() {
+  return this->onLine == OFF and this->opMode == COMMAND_MODE and
+         this->dlPending == OFF and this->cdPending == OFF and
+         ring.state == RING_IDLE and (not this->hasRing()) and cfg->sregs[1] == 0;
+}
+
+/**
+  Power down until RING, DTR or the serial input change.  The ADC is
+  stopped and all the clocks with it; the serial char that wakes us is
+  lost, as the USART does not run.
+*/
+void AFSK::powerDown() {
+  // Let the serial output complete
+  Serial.flush();
+  cli();
+  // Stop the ADC
+  uint8_t adcsra = ADCSRA;
+  ADCSRA = adcsra & ~_BV(ADEN);
+  // Wake up on RING (PCINT18) and RX (PCINT16) changes too, DTR is there
+  PCMSK2 |= _BV(PCINT18) | _BV(PCINT16);
+  PCIFR   = _BV(PCIF2);
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  sleep_enable();
+  // The next instruction after sei is executed before any interrupt
+  sei();
+  sleep_cpu();
+  sleep_disable();
+  // Back to the pin change wake up sources we had
+  cli();
+  PCMSK2 &= ~(_BV(PCINT18) | _BV(PCINT16));
+  // Restart the ADC
+  ADCSRA = adcsra | _BV(ADSC);
+  sei();
+  // The RING falling edge was not seen while the clocks were stopped
+  if (not (PIND & _BV(PORTD2)))
+    this->ringEdge();
 }
 
 /**
@@ -916,13 +1656,41 @@ void AFSK::setDirection(uint8_t dir, uint8_t rev) {
     fsqTX = &cfgAFSK.answ;
     fsqRX = &cfgAFSK.orig;
   }
+  // Keep the wave steps and the polarity at hand for the ISR
+  tx.step[SPACE] = fsqTX->step[SPACE];
+  tx.step[MARK]  = fsqTX->step[MARK];
+  rx.polarity    = fsqRX->polarity;
   // Clear the FIFOs
   rxFIFO.clear();
   txFIFO.clear();
-  // Prepare the delay queue for RX
+  spFIFO.clear();
+  rxLost = 0;
+#if TX_RAMP > 0
+  // Raised cosine ramp of the wave steps, from SPACE to MARK
+  for (uint8_t i = 0; i <= TX_RAMP; i++)
+    tx.ramp[i] = tx.step[SPACE] + ((float)tx.step[MARK] - tx.step[SPACE]) *
+                 (1.0 - cos(PI * i / TX_RAMP)) / 2.0 + 0.5;
+  tx.rmp = TX_RAMP;
+#endif
+#ifdef TX_NOISE_SHAPING
+  // Put the zero of the noise shaping filter on the RX band centre
+  tx.nsCoef = 32768.0 * cos(PI * (fsqRX->freq[SPACE] + fsqRX->freq[MARK]) / F_SAMPLE);
+  tx.nsErr[0] = 0;
+  tx.nsErr[1] = 0;
+#endif
+  // Reset the AFC to the discriminator levels of the nominal RX tones,
+  // having the peak amplitude AGC_TARGET
+  float t = TWO_PI * fsqRX->queuelen / F_SAMPLE;
+  rx.afcSpc = AGC_TARGET * AGC_TARGET / 2 * cos(t * fsqRX->freq[SPACE]);
+  rx.afcMrk = AGC_TARGET * AGC_TARGET / 2 * cos(t * fsqRX->freq[MARK]);
+  rx.afcThr = (rx.afcSpc + rx.afcMrk) >> 1;
+  // Reset the RX band-pass filter
+  memset(rx.bpfX, 0, sizeof(rx.bpfX));
+  rx.bpfIdx = 0;
+  // Prepare the delay queue for RX, with filtered (signed) silence
   dyFIFO.clear();
   for (uint8_t i = 0; i < fsqRX->queuelen; i++)
-    dyFIFO.in(bias);
+    dyFIFO.in(0);
 }
 
 /**
@@ -946,8 +1714,15 @@ void AFSK::setLine(uint8_t online) {
     this->setMode(COMMAND_MODE);
   }
   else {
-    // Select the jack
-    selDAC = cfg->jcksel;
+    // Select the jack: the DAC registers for TX and the speaker
+    if (cfg->jcksel == 1) {
+      priOCR = &OCR2B;
+      secOCR = &OCR2A;
+    }
+    else {
+      priOCR = &OCR2A;
+      secOCR = &OCR2B;
+    }
     // OH led on
     PORTB |= _BV(PORTB4);
     // DSR always on if &S0
@@ -971,6 +1746,18 @@ bool AFSK::getLine() {
   @param mode command mode or data mode
 */
 void AFSK::setMode(uint8_t mode) {
+  if (mode == DATA_MODE) {
+    // Set the escape character, the guard time and the options (S2,
+    // S12, S13), as they are now
+    escChar  = cfg->sregs[2];
+    escGuard = cfg->sregs[12] * 20;
+    escOpt   = cfg->sregs[13];
+    escCount = 0;
+    brkCnt   = 0;
+    brkSeen  = OFF;
+  }
+  // Detect the serial BREAK only in data mode
+  brkOn = (mode == DATA_MODE) and (escOpt & ESC_BREAK);
   // Keep the mode
   this->opMode = mode;
 }
@@ -1017,11 +1804,11 @@ void AFSK::setRxCarrier(uint8_t onoff) {
 }
 
 /**
-  Check the incoming carrier
-
-  @return the carrier detection status
+  Start waiting for the incoming carrier.  The RX decoder validates it,
+  while doEvents reports the detection, or its timeout, as a serial I/O
+  event.
 */
-bool AFSK::getRxCarrier() {
+void AFSK::waitRxCarrier() {
   // If the value specified in S7 is zero or &C0 or &L1,
   // don't wait for the carrier, report as found
   if ((cfg->sregs[7] == 0) or (cfg->dcdopt == 0) or (cfg->lnetpe == 1)) {
@@ -1038,27 +1825,79 @@ bool AFSK::getRxCarrier() {
     cdCount = 0;
     // Check the carrier for at most S7 seconds
     cdTOut = millis() + cfg->sregs[7] * 1000UL;
-    while (millis() <= cdTOut)
-      // Stop checking if there is any char on serial
-      // or the carrier has been detected
-      if (Serial.available() or rx.carrier == ON)
-        break;
-    // No RX if carrier not detected
-    if (not rx.carrier)
-      rx.state = NOP;
   }
-  // Return the carrier status (only true/false)
-  return rx.carrier;
+  // Let doEvents report the result
+  this->cdPending = ON;
+}
+
+/**
+  Set the CPU frequency correction and the sampling timer top
+
+  @param fcor the CPU frequency correction (Hz)
+*/
+void AFSK::setClock(int32_t fcor) {
+  fCor = fcor;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    ICR1 = ((F_CPU + fCor) / ((uint32_t)F_SAMPLE * ADC_OVS)) - 1;
+  }
 }
 
 /**
-  Dial a number
+  Start the sampling clock calibration on the received carrier, taking
+  the far end MARK tone as reference.  Measure for the specified time,
+  doEvents reports its end, or its abort by any char on serial or by
+  the carrier loss, as a serial I/O event.
+
+  @param secs the measuring time
+  @return false if there is no RX carrier
+*/
+bool AFSK::calStart(uint8_t secs) {
+  // Need the RX carrier
+  if (this->onLine == OFF or rx.carrier == OFF)
+    return false;
+  this->calTOut = millis() + secs * 1000UL;
+  this->calPending = ON;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    cal.valid   = OFF;
+    cal.pos     = OFF;
+    cal.clk     = 0;
+    cal.periods = 0;
+    cal.samples = 0;
+    cal.active  = ON;
+  }
+  return true;
+}
+
+/**
+  Stop measuring the received carrier and compute the CPU frequency
+  correction: the sampling clock is faster than nominal by the ratio of
+  the reference MARK frequency to the measured one.
+
+  @return true if the correction has been updated
+*/
+bool AFSK::calEnd() {
+  cal.active = OFF;
+  // Need at least one second of carrier
+  if (cal.periods < fsqRX->freq[MARK])
+    return false;
+  // The actual over the nominal sampling frequency
+  float ratio = (float)fsqRX->freq[MARK] * cal.samples / ((float)cal.periods * F_SAMPLE);
+  // Refuse errors over 2%, no resonator is that bad
+  if (fabs(ratio - 1.0) > 0.02)
+    return false;
+  // The actual CPU frequency, with the current sampling timer top
+  float fcpu = ((uint32_t)ICR1 + 1) * (float)F_SAMPLE * ADC_OVS * ratio;
+  this->setClock(lround(fcpu - F_CPU));
+  return true;
+}
+
+/**
+  Start dialing a number.  The ISR sends the DTMF tones, while doEvents
+  reports the end of dialing, or its abort, as a serial I/O event.
 
   @param phone the number to dial
-  @return true if completed, false if interrupted
 */
-bool AFSK::dial(char *phone) {
-  bool result = true;
+void AFSK::dial(char *phone) {
   // If leased line (&L1), do not dial
   if (cfg->lnetpe == 0) {
     // Disable the TX carrier
@@ -1077,18 +1916,9 @@ bool AFSK::dial(char *phone) {
     txFIFO.in(',');
     // Start dialing
     this->isDialing = ON;
-    // Block until dialing is over
-    while (this->isDialing == ON) {
-      // Stop dialing if there is any char on serial
-      if (Serial.available()) {
-        this->isDialing = OFF;
-        result = false;
-      }
-      // Busy delay
-      delay(10);
-    }
   }
-  return result;
+  // Let doEvents report the end
+  this->dlPending = ON;
 }
 
 /**
@@ -1105,12 +1935,36 @@ uint32_t AFSK::callTime() {
   return result;
 }
 
+/**
+  Get the frequency offset of the received tones.  The discriminator
+  output is A * cos(2 * PI * f * T), T being the delay queue length,
+  so the AFC average levels for MARK and SPACE solve for the common
+  offset, whatever the amplitude A.
+
+  @return the frequency offset of the received tones, in Hz
+*/
+int16_t AFSK::getFreqOffset() {
+  int16_t m, s;
+  // The levels are updated in ISR
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    m = rx.afcMrk;
+    s = rx.afcSpc;
+  }
+  // The phase shifts of the nominal tones in the delay queue
+  float t = TWO_PI * fsqRX->queuelen / F_SAMPLE;
+  float a = t * fsqRX->freq[MARK];
+  float b = t * fsqRX->freq[SPACE];
+  // m * cos(b + d) = s * cos(a + d), solve for d
+  float d = atan((m * cos(b) - s * cos(a)) / (m * sin(b) - s * sin(a)));
+  return round(d / t);
+}
+
 /**
   Test case simulation: feed the RX demodulator
 */
 void AFSK::simFeed() {
   // Simulation
-  static uint16_t idx = 0;
+  static phase_t idx = 0;
   uint8_t bt = (millis() / 1000) % 2;
 
   int8_t x = wave.sample(idx);
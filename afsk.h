@@ -26,15 +26,87 @@
 
 //#define DEBUG_RX
 //#define DEBUG_RX_LVL
+//#define DEBUG_CYCLES
+
+// RX band-pass filter length (odd, at most 31) and its delay line mask
+#define BPF_TAPS 31
+#define BPF_MASK 0x1F
 
 #include <Arduino.h>
 #include <avr/wdt.h>
+#include <avr/sleep.h>
 
 #include "config.h"
 #include "fifo.h"
 #include "wave.h"
 #include "dtmf.h"
 
+// Echo canceller taps (at most 32, 0 to disable), adaptation step (as
+// right shift), double-talk detector threshold (as right shift of the
+// TX peak) and double-talk hangover (samples)
+#ifndef EC_TAPS
+#define EC_TAPS 8
+#endif
+#define EC_MASK 0x1F
+#define EC_MU   8
+#define EC_DTD  1
+#define EC_HOLD 240
+
+// TX frequency transitions length, in samples (0 to switch instantly)
+#ifndef TX_RAMP
+#define TX_RAMP 0
+#endif
+
+// AGC target peak level and maximum gain (Q8)
+#define AGC_TARGET  96
+#define AGC_MAXGAIN 0x2000
+
+// Impulse blanker: minimum and maximum thresholds, samples blanked after an impulse
+#define BLK_MIN   16
+#define BLK_MAX   120
+#define BLK_HOLD  4
+
+// AFC slicer adaptation rate (shift, 1/8 per received character)
+#ifndef AFC_RATE
+#define AFC_RATE 3
+#endif
+
+// Fixed bit timing: all modem types are 300 baud, 8 data bits, so the
+// bit lengths in samples are constants for the ISR (0 to take them from
+// the modem type, at runtime)
+#ifndef AFSK_FIXED
+#define AFSK_FIXED 1
+#endif
+#define AFSK_BAUD   300
+#define AFSK_DTBITS 8
+#if AFSK_FIXED and (F_SAMPLE % AFSK_BAUD) != 0
+#error "F_SAMPLE must be a multiple of the baud rate"
+#endif
+
+// ADC oversampling ratio (1, 2 or 4): the ADC runs at ADC_OVS * F_SAMPLE
+// and a polyphase FIR filter decimates the input to F_SAMPLE; taps of
+// each phase of the decimator
+#ifndef ADC_OVS
+#define ADC_OVS 1
+#endif
+#define OVS_TAPS 6
+
+// FIFOs size, in bits (16 to 128 bytes)
+#ifndef FIFO_BITS
+#define FIFO_BITS 6
+#endif
+
+// Size of the buffer holding the received data in online command mode,
+// in bits (16 to 128 bytes)
+#ifndef SPILL_BITS
+#define SPILL_BITS 7
+#endif
+
+// Power down after this many seconds idle, on-hook (0 to disable)
+#ifndef PWR_DOWN
+#define PWR_DOWN 0
+#endif
+
 // Mark and space bits
 enum BIT {SPACE, MARK};
 // States in RX and TX finite states machines
@@ -47,39 +119,138 @@ enum MODES {COMMAND_MODE, DATA_MODE};
 enum FLOWCONTROL {FC_NONE = 0, FC_RTSCTS = 3, FC_XONXOFF = 4};
 // On / Off
 enum ONOFF {OFF, ON};
-
-// Transmission related data
+// States of the ring cadence detector
+enum RING_STATE {RING_IDLE, RING_ON, RING_OFF};
+// Serial I/O events reported by the serial I/O tasks, besides the hayes result codes
+enum SIO_EVENTS {SIO_CAL_DONE = 247, SIO_CAL_ABORT = 248, SIO_ESC_AT = 249, SIO_CD_ON = 250, SIO_CD_OFF = 251, SIO_DIAL_DONE = 252, SIO_DIAL_ABORT = 253,
+                 SIO_NONE = 254
+                };
+
+// Transmission related data, the per sample state first
 struct TX_t {
+  phase_t idx     = 0;        // Wave phase accumulator (start with first sample)
+  phase_t step[2] = {0, 0};   // Wave index steps for SPACE and MARK
+  uint8_t clk     = 0;        // samples counter for each bit
+  uint8_t dtbit   = MARK;     // currently transmitting data bit
   uint8_t active  = 0;        // currently transmitting something or not
+  uint8_t carrier = OFF;      // outgoing carrier enabled or not
   uint8_t state   = WAIT;     // TX state (TXRX_STATE enum)
-  uint8_t dtbit   = MARK;     // currently transmitting data bit
   uint8_t data    = 0;        // transmitting data bits, shift out, LSB first
   uint8_t bits    = 0;        // counter of already transmitted bits
-  uint16_t idx    = 0;        // Q8.8 wave samples index (start with first sample)
-  uint8_t clk     = 0;        // samples counter for each bit
-  uint8_t carrier = OFF;      // outgoing carrier enabled or not
+#if TX_RAMP > 0
+  uint8_t rmp     = TX_RAMP;  // position on the SPACE to MARK ramp
+  phase_t ramp[TX_RAMP + 1];  // raised cosine ramp of wave steps, SPACE to MARK
+#endif
+#ifdef TX_NOISE_SHAPING
+  int16_t nsCoef  = 0;        // Noise shaping, 2 * cos of the RX band centre (Q14)
+  int16_t nsErr[2] = {0, 0};  // Noise shaping, last quantization errors (Q8)
+#endif
 };
 
-// Receiving and decoding related data
+// Receiving and decoding related data, the per sample state first and
+// the delay line, indexed anyway, last
 struct RX_t {
-  uint8_t active  = 0;        // currently receiving something or not
   uint8_t state   = WAIT;     // RX decoder state (TXRX_STATE enum)
-  uint8_t data    = 0;        // the received data bits, shift in, LSB first
-  uint8_t bits    = 0;        // counter of received data bits
+  uint8_t clk     = 0;        // samples counter for each bit
   uint8_t stream  = 0;        // last 8 decoded bit samples
   uint8_t bitsum  = 0;        // sum of the last decoded bit samples
-  uint8_t clk     = 0;        // samples counter for each bit
-  uint8_t carrier = OFF;      // incoming carrier detected or not
   int16_t iirX[2] = {0, 0};   // IIR Filter X cells
   int16_t iirY[2] = {0, 0};   // IIR Filter Y cells
+  int16_t afcThr  = 0;        // AFC slicer threshold
+  int16_t afcAcc  = 0;        // AFC discriminator accumulator (8 samples)
+  uint8_t polarity = 0;       // symbol polarity for the delay queue
+  uint8_t active  = 0;        // currently receiving something or not
+  uint8_t bpfIdx  = 0;        // Band-pass filter delay line index
+  uint8_t blkPeak = 0;        // Impulse blanker input peak level
+  uint8_t blkLim  = BLK_MAX;  // Impulse blanker threshold
+  uint8_t blkCnt  = 0;        // Impulse blanker samples counter
+  uint8_t blkHold = 0;        // Impulse blanker remaining samples to blank
+  uint8_t agcCnt  = 0;        // AGC samples counter
+  uint16_t agcPeak = 0;       // AGC input peak level (Q4)
+  uint8_t data    = 0;        // the received data bits, shift in, LSB first
+  uint8_t bits    = 0;        // counter of received data bits
+  uint8_t carrier = OFF;      // incoming carrier detected or not
+  int16_t afcNew  = 0;        // AFC discriminator level of the last start bit
+  int16_t afcSpc  = 0;        // AFC average discriminator level for SPACE
+  int16_t afcMrk  = 0;        // AFC average discriminator level for MARK
+  int8_t  bpfX[BPF_MASK + 1] = {0}; // Band-pass filter delay line
+};
+
+#if EC_TAPS > 0
+// Echo canceller related data
+struct EC_t {
+  int8_t  x[EC_MASK + 1] = {0}; // TX samples delay line
+  int16_t w[EC_TAPS] = {0};     // adaptive filter weights (Q14)
+  uint8_t idx     = 0;          // delay line index (newest TX sample)
+  uint8_t hold    = 0;          // double-talk hangover counter
+};
+#endif
+
+#if ADC_OVS > 1
+// Oversampled input decimator related data
+struct OVS_t {
+  int16_t acc[OVS_TAPS] = {0};  // partial outputs, the current one first (Q7)
+  int8_t  coef[ADC_OVS * OVS_TAPS]; // low-pass filter coefficients (Q7)
+  uint8_t phase   = 0;          // input sample position in the output period
+  uint8_t out     = 0x80;       // the last output sample
+  uint8_t busy    = 0;          // still handling the last output sample
+};
+#endif
+
+// Sampling clock calibration: the hysteresis of the zero crossing detector
+#define CAL_HYST 16
+
+// Sampling clock calibration related data
+struct CAL_t {
+  uint8_t  active  = OFF;     // measuring or not
+  uint8_t  valid   = OFF;     // the last rising zero crossing is known
+  uint8_t  pos     = OFF;     // in the positive half of the carrier wave
+  uint16_t clk     = 0;       // samples since the last rising zero crossing
+  uint16_t periods = 0;       // count of measured carrier periods
+  uint32_t samples = 0;       // samples in the measured carrier periods
+};
+
+// Ring cadence detector, in ticks of 10ms: the RING input is active while
+// low or for RING_HOLD after it was low (the ring voltage may be rectified
+// or not); a ring burst is valid after RING_ON_MIN and stuck after
+// RING_ON_MAX; bursts less than RING_PAUSE apart are the same ring (double
+// ring cadences); no ring for RING_OFF_MAX ends the series
+#define RING_TICK     (F_SAMPLE / 100)
+#define RING_HOLD     10
+#define RING_ON_MIN   15
+#define RING_ON_MAX   300
+#define RING_PAUSE    100
+#define RING_OFF_MAX  800
+// DTR input debounce time, in samples (20ms)
+#define DTR_DEBOUNCE  (F_SAMPLE / 50)
+
+// Escape options (S13): "+++AT" with no guard time (TIES), serial BREAK,
+// no escape sequence at all (the escape chars are data)
+#define ESC_TIES  0x01
+#define ESC_BREAK 0x02
+#define ESC_NONE  0x04
+// Serial BREAK: the RX input low for this many samples (100ms)
+#define BRK_TIME  (F_SAMPLE / 10)
+
+// Ring cadence detector related data
+struct RING_t {
+  uint8_t  state   = RING_IDLE; // detector state (RING_STATE enum)
+  uint8_t  sub     = 0;         // samples counter for each tick
+  uint8_t  hold    = 0;         // ticks left until the burst ends
+  uint8_t  valid   = OFF;       // the current ring has been counted
+  uint16_t ticks   = 0;         // ticks in the current state
+  volatile uint8_t edge = OFF;  // falling edge seen on the input
+  volatile uint8_t news = 0;    // rings not yet reported
+  volatile uint8_t over = OFF;  // the ring series is over, not yet reported
 };
 
 // Frequencies, wave index steps, autocorrelation queue length
 struct AFSK_FSQ_t {
   uint16_t  freq[2];  // Frequencies for SPACE and MARK
-  uint16_t  step[2];  // Wave index steps for SPACE and MARK (Q8.8)
-  uint8_t   queuelen; // Autocorrelation queue length
+  phase_t   step[2];  // Wave index steps for SPACE and MARK
+  uint8_t   queuelen; // Autocorrelation queue length (given at 9600Hz)
   uint8_t   polarity; // Symbol polarity for specified queue
+  int8_t    coef[BPF_TAPS / 2 + 1]; // Band-pass filter, first half (Q9)
 };
 
 // AFSK configuration structure
@@ -94,32 +265,54 @@ struct AFSK_t {
 
 // Bell103 configuration
 static AFSK_t BELL103 = {
-  {{1070, 1270}, {0, 0}, 10, 1},
-  {{2025, 2225}, {0, 0},  8, 0},
+  {{1070, 1270}, {0, 0}, 10, 1, {}},
+  {{2025, 2225}, {0, 0},  8, 0, {}},
   300, 8, 1,
 };
 
 // V.21 configuration
 static AFSK_t V_21 = {
-  {{1180,  980}, {0, 0}, 11, 0},
-  {{1850, 1650}, {0, 0},  7, 0},
+  {{1180,  980}, {0, 0}, 11, 0, {}},
+  {{1850, 1650}, {0, 0},  7, 0, {}},
   300, 8, 1,
 };
 
 class AFSK {
+  private:
+    // The per sample state comes first: the ISR reaches it from 'this'
+    // with displacement addressing, limited to 63 bytes on AVR
+    TX_t tx;
+    uint8_t rxSample;
+    uint8_t txSample;
+    RX_t rx;
+
   public:
-    uint8_t bias      = 0x80;   // Input line level bias
+    uint8_t bias      = 0x80;   // Input line level bias (DC offset)
+    uint8_t level     = 0x00;   // Input line level in RX band (peak)
+    uint16_t gain     = 0x0100; // AGC gain (Q8)
+    uint16_t blanked  = 0;      // Input samples blanked as impulse noise
+    volatile uint16_t rxLost = 0; // Received bytes lost, the RX FIFO being full
+    volatile uint16_t ovsLost = 0; // Decimated samples lost, the previous still handled (ADC_OVS)
     uint8_t carBits   = 240;    // Number of carrier bits to send in preamble and trail
+    int32_t fCor      = F_COR;  // CPU frequency correction for the sampling timer
 
 #ifdef DEBUG_RX_LVL
     uint8_t inLevel   = 0x00;   // Get the input level
 #endif
 
+#ifdef DEBUG_CYCLES
+    uint16_t cycMax   = 0;      // Maximum CPU cycles spent in doTXRX
+    uint32_t cycSum   = 0;      // Total CPU cycles spent in doTXRX ...
+    uint16_t cycCnt   = 0;      // ... over this many samples
+#endif
+
     AFSK();
     ~AFSK();
 
     void init(AFSK_t afsk, CFG_t *conf);
     void initSteps();
+    void initFilters();
+    void initQueues();
     void setModemType(AFSK_t afsk);
     void setDirection(uint8_t dir, uint8_t rev = OFF);
     void setLine(uint8_t online);
@@ -128,13 +321,34 @@ class AFSK {
     bool getMode();
     void setTxCarrier(uint8_t onoff);
     void setRxCarrier(uint8_t onoff);
-    bool getRxCarrier();
-    bool dial(char *phone);
+    void waitRxCarrier();
+    void dial(char *phone);
     void doTXRX();
     void setLeds(uint8_t onoff);
     void clearRing();
-    uint8_t doSIO();
+    bool    hasEvents();
+    uint8_t doEvents();
+    void    ringEdge();
+    bool    hasRing();
+    uint8_t doRing();
+    uint8_t doEscape();
+    void    dtrEdge();
+    bool    hasDTR();
+    uint8_t doDTR();
+    void    doFlow();
+    bool    hasData();
+    uint8_t doData();
+    bool    hasCommand();
+    bool    hasSpill();
+    void    doSpill();
+    uint8_t spillLen();
+    bool    isIdle();
+    void    powerDown();
     uint32_t callTime();
+    void setClock(int32_t fcor);
+    bool calStart(uint8_t secs);
+    bool calEnd();
+    int16_t getFreqOffset();
 
     void simFeed();             // Simulation
     void simPrint();
@@ -147,47 +361,89 @@ class AFSK {
     uint8_t opMode    = COMMAND_MODE;   // Modem works in data mode or in command mode
     uint8_t direction = ORIGINATING;
     uint8_t isDialing = OFF;
+    uint8_t dlPending = OFF;            // Dialing started, its end not yet reported
+    uint8_t cdPending = OFF;            // Waiting for the RX carrier, not yet reported
+    uint8_t calPending = OFF;           // Calibrating, its end not yet reported
 
     uint16_t _commaCnt;
     uint16_t _commaMax;
 
     uint16_t escGuard;
     char     escChar;
-
+    uint8_t  escCount = 0;  // Escape chars seen so far
+    uint32_t escFirst = 0;  // Time of the first escape char
+    uint32_t escLast  = 0;  // Time of the last escape char
+    uint32_t lstChar  = 0;  // Time of the last data char
+    uint8_t  escOpt   = 0;  // Escape options (S13)
+    char     escA     = 'A';// The 'A' after a TIES "+++", as received
+    uint8_t  brkOn    = OFF;// Detect the serial BREAK
+    uint16_t brkCnt   = 0;  // Samples with the RX input low
+    volatile uint8_t brkSeen = OFF; // Serial BREAK detected
+
+#if AFSK_FIXED
+    static const uint8_t fulBit = F_SAMPLE / AFSK_BAUD;
+    static const uint8_t hlfBit = fulBit >> 1;
+    static const uint8_t qrtBit = hlfBit >> 1;
+    static const uint8_t octBit = qrtBit >> 1;
+    static const uint8_t dtBits = AFSK_DTBITS;
+#else
     uint8_t fulBit, hlfBit, qrtBit, octBit;
+    uint8_t dtBits;
+#endif
 
     // Carrier detect counter and threshold
     uint32_t cdCount; // samples counter and call timer
     uint32_t cdTotal; // total samples to count
     uint32_t cdTOut;  // RX carrier timeout
+    uint32_t calTOut; // Calibration end
 
     // Serial flow control tracking status
     bool inFlow = false;
     bool outFlow = false;
 
-    // Ring
-    uint32_t inpRingTimeout;
-    uint32_t outRingTimeout;
+    // Ring and DTR inputs
+    RING_t ring;
+    uint16_t dtrDbc = 0;            // DTR debounce samples counter
+    volatile uint8_t dtrChg = OFF;  // DTR input changed
+    volatile uint8_t dtrLow = OFF;  // DTR input low (debounced)
 
 
-    TX_t tx;
-    RX_t rx;
+#if EC_TAPS > 0
+    EC_t ec;
+#endif
+#if ADC_OVS > 1
+    OVS_t ovs;
+#endif
+    CAL_t cal;
 
     AFSK_FSQ_t *fsqTX;
     AFSK_FSQ_t *fsqRX;
 
-    uint8_t rxSample;
-    uint8_t txSample;
+    uint16_t biasAcc = 0x8000;      // DC bias estimator (Q8)
 
-    uint8_t selDAC;
+    volatile uint8_t *priOCR = &OCR2A;  // Primary DAC register (TX)
+    volatile uint8_t *secOCR = &OCR2B;  // Secondary DAC register (speaker)
     inline void priDAC(uint8_t sample);
     inline void secDAC(uint8_t sample);
 
     void initHW();
     void txHandle();
+#ifdef TX_NOISE_SHAPING
+    uint8_t nsHandle(phase_t idx);
+#endif
+#if ADC_OVS > 1
+    bool ovsHandle(uint8_t sample);
+#endif
     void rxHandle(uint8_t sample);
+    uint8_t blkHandle(uint8_t sample);
+    int16_t bpfHandle(int8_t sample);
+    int8_t agcHandle(int16_t sample);
+    int8_t ecHandle(int8_t sample);
     void rxDecoder(uint8_t bt);
     void spkHandle();
+    void pinHandle();
+    void brkHandle();
+    void escFlush(uint32_t now);
 
 #ifdef DEBUG_RX_LVL
     // Count input samples and get the minimum, maximum and input level
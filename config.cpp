@@ -132,11 +132,8 @@ bool Profile::read(CFG_t *cfg, uint8_t slot, bool useDefaults) {
   EEPROM.get(eeAddress + slot * eeProfLen, cfgTemp);
   // Compute the CRC8 checksum of the read data
   uint8_t crc8 = this->crc(&cfgTemp);
-  // And compare with the read crc8 checksum, also check S1 and S2
-  if (cfgTemp.crc8 == crc8 and
-      cfgTemp.sregs[1] == 0 and
-      cfgTemp.sregs[2] >= ' ' and
-      cfgTemp.sregs[2] <= '~')
+  // Check the crc8 checksum and the fields
+  if (this->valid(&cfgTemp))
     // Copy the temporary structure to configuration and the crc8
     for (uint8_t i = 0; i < eeProfLen; i++)
       cfg->data[i] = cfgTemp.data[i];
@@ -145,6 +142,21 @@ bool Profile::read(CFG_t *cfg, uint8_t slot, bool useDefaults) {
   return (cfgTemp.crc8 == crc8);
 }
 
+/**
+  Check a configuration before using it: the crc8 checksum, S1, S2 and
+  the DTE speed
+
+  @param cfg the configuration structure
+  @return true if valid
+*/
+bool Profile::valid(CFG_t *cfg) {
+  return cfg->crc8 == this->crc(cfg) and
+         cfg->sregs[1] == 0 and
+         cfg->sregs[2] >= ' ' and
+         cfg->sregs[2] <= '~' and
+         cfg->dterte < dteRatesNum;
+}
+
 /**
   Reset the configuration to factory defaults
 
@@ -176,6 +188,9 @@ bool Profile::factory(CFG_t *cfg) {
   // Set the S regs
   memcpy_P(&cfg->sregs, &sRegs, 16);
 
+  // DTE serial speed, 300 bps
+  cfg->dterte = 0x00; // AT+IPR
+
   //Always return true
   return true;
 };
@@ -238,3 +253,62 @@ void Profile::pbSet(char *phone, uint8_t slot) {
     if (phone[i] == '\0') break;
   }
 }
+
+/**
+  Check a char to be stored in a phone number: digits, 'A' to 'D', '*',
+  '#' and the pause ','
+
+  @param c the char
+  @return true if it can be stored
+*/
+bool Profile::pbChar(char c) {
+  return isdigit(c) or (c >= 'A' and c <= 'D') or
+         c == '*' or c == '#' or c == ',';
+}
+
+/**
+  Get the stored sampling clock correction, along with CRC8, and verify
+
+  @param fcor the CPU frequency correction (Hz)
+  @return CRC verification
+*/
+bool Profile::corGet(int32_t *fcor) {
+  uint8_t data[sizeof(int32_t) + 1];
+  // Read the correction and its CRC8
+  EEPROM.get(eeCorAddr, data);
+  // Compute the CRC8 checksum of the read data
+  uint8_t crc8 = 0;
+  for (uint8_t i = 0; i < sizeof(int32_t); i++)
+    crc8 = this->CRC8(crc8, data[i]);
+  // Use the correction only if valid
+  if (data[sizeof(int32_t)] != crc8)
+    return false;
+  memcpy(fcor, data, sizeof(int32_t));
+  return true;
+}
+
+/**
+  Store the sampling clock correction, along with CRC8
+
+  @param fcor the CPU frequency correction (Hz)
+*/
+void Profile::corSet(int32_t fcor) {
+  uint8_t data[sizeof(int32_t) + 1];
+  memcpy(data, &fcor, sizeof(int32_t));
+  // Compute the CRC8 checksum of the data
+  uint8_t crc8 = 0;
+  for (uint8_t i = 0; i < sizeof(int32_t); i++)
+    crc8 = this->CRC8(crc8, data[i]);
+  data[sizeof(int32_t)] = crc8;
+  // Store only the changed bytes
+  EEPROM.put(eeCorAddr, data);
+}
+
+/**
+  Clear the stored sampling clock correction, as erased EEPROM, which
+  does not pass the CRC8 verification
+*/
+void Profile::corClear() {
+  for (uint8_t i = 0; i <= sizeof(int32_t); i++)
+    EEPROM.update(eeCorAddr + i, 0xFF);
+}
@@ -26,8 +26,10 @@
 // Include local configuration
 #include "local.h"
 
-// Sampling frequency
+// Sampling frequency, a multiple of the baud rate (7200 or 9600)
+#ifndef F_SAMPLE
 #define F_SAMPLE    9600
+#endif
 
 // Software name and vesion
 const char DEVNAME[]  PROGMEM = "Arabell300";
@@ -44,6 +46,12 @@ const uint8_t   eeProfNums  = 4;      // Number of configuration profiles to sto
 const uint8_t   eeProfLen   = 32;     // Reserved profile lenght
 const uint8_t   eePhoneNums = 8;      // Number of phone numbers to store
 const uint8_t   eePhoneLen  = 32;     // Reserved phone number lenght
+const uint16_t  eeCorAddr   = eeAddress + eeProfNums * eeProfLen + eePhoneNums * eePhoneLen; // Sampling clock correction
+
+// DTE serial speeds (AT+IPR), the profile keeps the index
+const uint32_t  dteRates[]  PROGMEM = {300, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200};
+const uint8_t   dteRatesNum = sizeof(dteRates) / sizeof(dteRates[0]);
+
 struct CFG_t {
   union {
     struct {
@@ -69,6 +77,7 @@ struct CFG_t {
       uint8_t dsropt: 2;  // AT&S DSR option selection
 
       uint8_t sregs[16];  // The S registers
+      uint8_t dterte;     // AT+IPR DTE serial speed (index in dteRates)
     };
     uint8_t data[eeProfLen];
   };
@@ -88,7 +97,7 @@ const uint8_t sRegs[16] PROGMEM = {0,     //  0 Rings to Auto-Answer
                                    14,    // 10 Carrier Loss Disconnect Time (tenths of a second)
                                    95,    // 11 DTMF Tone Duration
                                    50,    // 12 Escape Prompt Delay
-                                   0,     // 13 Reserved
+                                   0,     // 13 Escape Options
                                    0,     // 14 General Bit Mapped Options Status
                                    0      // 15 Reserved
                                   };
@@ -104,6 +113,7 @@ class Profile {
     bool    read (CFG_t *cfg, uint8_t slot = 0, bool useDefaults = false);
     bool    write(CFG_t *cfg, uint8_t slot = 0);
     bool    factory(CFG_t *cfg);
+    bool    valid(CFG_t *cfg);
 
     // S registers data and functions
     uint8_t sregGet(CFG_t *cfg, uint8_t reg);
@@ -112,10 +122,17 @@ class Profile {
     // Phone numbers storage
     uint8_t pbGet(char *phone, uint8_t slot);
     void pbSet(char *phone, uint8_t slot);
+    bool pbChar(char c);
+
+    // Sampling clock correction storage
+    bool    corGet(int32_t *fcor);
+    void    corSet(int32_t fcor);
+    void    corClear();
+
+    uint8_t CRC8(uint8_t inCrc, uint8_t inData);
 
   private:
     uint8_t crc(CFG_t *cfg);
-    uint8_t CRC8(uint8_t inCrc, uint8_t inData);
     bool    equal(CFG_t *cfg1, CFG_t *cfg2);
 };
 
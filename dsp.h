@@ -0,0 +1,95 @@
+/**
+  dsp.h - Signed multiplication kernels for the RX filters
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DSP_H
+#define DSP_H
+
+#include <Arduino.h>
+
+/*
+  On AVR, avr-gcc promotes the operands to int16 or int32 and, for the
+  16x8 products, calls the libgcc multiplication routines.  These kernels
+  use the hardware MULS/MULSU directly.  Elsewhere, the C++ versions give
+  the very same results.
+*/
+
+/**
+  Signed 8 by 8 bits multiplication
+
+  @param a the first factor
+  @param b the second factor
+  @return the 16 bits product
+*/
+static inline int16_t mulS8(int8_t a, int8_t b) {
+#ifdef __AVR__
+  int16_t r;
+  asm (
+    "muls  %[a], %[b]"      "\n\t"
+    "movw  %A[r], r0"       "\n\t"
+    "clr   __zero_reg__"    "\n\t"
+    : [r] "=&r" (r)
+    : [a] "d" (a), [b] "d" (b)
+  );
+  return r;
+#else
+  return (int16_t)a * b;
+#endif
+}
+
+/**
+  Signed 16 by 8 bits multiply and accumulate, as two 8x8 products: the
+  low byte is unsigned (MULSU), the high byte signed (MULS), shifted by 8
+
+  @param acc the 32 bits accumulator
+  @param a the 16 bits factor
+  @param b the 8 bits factor
+  @return the accumulator plus the product
+*/
+static inline int32_t macS16S8(int32_t acc, int16_t a, int8_t b) {
+#ifdef __AVR__
+  uint8_t s;
+  asm (
+    // Low byte: acc += b * lo(a)
+    "mulsu %[b], %A[a]"     "\n\t"
+    "clr   %[s]"            "\n\t"
+    "sbrc  r1, 7"           "\n\t"
+    "com   %[s]"            "\n\t"
+    "add   %A[acc], r0"     "\n\t"
+    "adc   %B[acc], r1"     "\n\t"
+    "adc   %C[acc], %[s]"   "\n\t"
+    "adc   %D[acc], %[s]"   "\n\t"
+    // High byte: acc += (b * hi(a)) << 8
+    "muls  %B[a], %[b]"     "\n\t"
+    "clr   %[s]"            "\n\t"
+    "sbrc  r1, 7"           "\n\t"
+    "com   %[s]"            "\n\t"
+    "add   %B[acc], r0"     "\n\t"
+    "adc   %C[acc], r1"     "\n\t"
+    "adc   %D[acc], %[s]"   "\n\t"
+    "clr   __zero_reg__"    "\n\t"
+    : [acc] "+r" (acc), [s] "=&r" (s)
+    : [a] "a" (a), [b] "a" (b)
+  );
+  return acc;
+#else
+  return acc + (int32_t)a * b;
+#endif
+}
+
+#endif /* DSP_H */
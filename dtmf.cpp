@@ -38,7 +38,7 @@ DTMF::~DTMF() {
 void DTMF::setDuration(uint8_t pulse, uint8_t pause) {
   // Make the pause equal to pulse, if not specified
   if (pause == 0) pause = pulse;
-  // Compute the wave steps, as Q8.8
+  // Compute the wave steps
   for (uint8_t i = 0; i < ROWSCOLS; i++) {
     stpRows[i] = wave.getStep(frqRows[i]);
     stpCols[i] = wave.getStep(frqCols[i]);
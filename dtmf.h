@@ -64,11 +64,11 @@ class DTMF {
   private:
     // The DTMF wave generator
     WAVE wave;
-    // Wave steps (Q8.8)
-    uint16_t stpRows[ROWSCOLS];
-    uint16_t stpCols[ROWSCOLS];
-    // Wave indices for row and col frequencies (Q8.8)
-    uint16_t rowIdx, colIdx;
+    // Wave steps
+    phase_t stpRows[ROWSCOLS];
+    phase_t stpCols[ROWSCOLS];
+    // Wave indices for row and col frequencies
+    phase_t rowIdx, colIdx;
     // Identified row and col
     uint8_t row, col;
     // Wave generator status
@@ -35,6 +35,8 @@ HAYES::~HAYES() {
 void HAYES::printCRLF() {
   Serial.write(cfg->sregs[3]);
   Serial.write(cfg->sregs[4]);
+  // Count the lines, for paging
+  outLines++;
 }
 
 /**
@@ -346,11 +348,36 @@ void HAYES::sregPrint(CFG_t *conf, uint8_t reg, bool newline) {
 }
 
 /**
-  Show a configuration profile
+  Show one line of a configuration profile: the main configuration, the
+  '&' configuration and the S registers, four at a time
 
   @param conf the configuration structure
+  @param line the line to show (0 to 5)
 */
-void HAYES::showProfile(CFG_t *conf) {
+void HAYES::showProfile(CFG_t *conf, uint8_t line) {
+  if (line >= 2) {
+    // Print the S registers, eight on a line
+    for (uint8_t reg = (line - 2) * 4; reg < (line - 1) * 4; reg++) {
+      sregPrint(conf, reg, false);
+      if (reg == 0x07 or reg == 0x0F)
+        printCRLF();
+    }
+    return;
+  }
+  if (line == 1) {
+    // Print the '&' configuration
+    cmdPrint('A', '&', conf->revans, false);
+    cmdPrint('C', '&', conf->dcdopt, false);
+    cmdPrint('D', '&', conf->dtropt, false);
+    cmdPrint('J', '&', conf->jcksel, false);
+    cmdPrint('K', '&', conf->flwctr, false);
+    cmdPrint('L', '&', conf->lnetpe, false);
+    cmdPrint('P', '&', conf->plsrto, false);
+    cmdPrint('R', '&', conf->rtsopt, false);
+    cmdPrint('S', '&', conf->dsropt, false);
+    printCRLF();
+    return;
+  }
   // Print the main configuration
   cmdPrint('B', conf->compro, false);
   cmdPrint('C', conf->txcarr, false);
@@ -363,22 +390,219 @@ void HAYES::showProfile(CFG_t *conf) {
   if (conf->dialpt) Serial.print(F("T "));
   cmdPrint('V', conf->verbal, false);
   cmdPrint('X', conf->selcpm, false);
+  Serial.print(F("+IPR="));
+  if (conf->dterte < dteRatesNum) Serial.print(pgm_read_dword(&dteRates[conf->dterte]));
+  else                            Serial.print('?');
+  Serial.print(F(" "));
   printCRLF();
-  cmdPrint('A', '&', conf->revans, false);
-  cmdPrint('C', '&', conf->dcdopt, false);
-  cmdPrint('D', '&', conf->dtropt, false);
-  cmdPrint('J', '&', conf->jcksel, false);
-  cmdPrint('K', '&', conf->flwctr, false);
-  cmdPrint('L', '&', conf->lnetpe, false);
-  cmdPrint('P', '&', conf->plsrto, false);
-  cmdPrint('R', '&', conf->rtsopt, false);
-  cmdPrint('S', '&', conf->dsropt, false);
-  printCRLF();
-  // Print the S registers
-  for (uint8_t reg = 0; reg < 16; reg++) {
-    sregPrint(conf, reg, false);
-    if (reg == 0x07 or reg == 0x0F)
+}
+
+/**
+  Show the next line of the configuration (AT&V): the active profile,
+  the stored profiles and the stored phone numbers, as selected
+
+  @return false if there is nothing more to show
+*/
+bool HAYES::showConfig() {
+  struct CFG_t cfgTemp;
+  char dn[eePhoneLen];
+  // Skip the sections which are not selected or are over: 0 is the
+  // active profile, 1 to eeProfNums the stored ones, then the phones
+  while (true) {
+    if (outSec == 0) {
+      if ((outSel == '0' or outSel == '\0') and outLine <= 6)
+        break;
+    }
+    else if (outSec <= eeProfNums) {
+      if ((outSel == '1' or outSel == '\0') and outLine <= 6)
+        break;
+    }
+    else if (outSec == eeProfNums + 1) {
+      if ((outSel == '2' or outSel == '\0') and outLine <= eePhoneNums)
+        break;
+    }
+    else
+      // All done
+      return false;
+    // Next section
+    outSec++;
+    outLine = 0;
+  }
+  // Show the line
+  if (outSec == 0) {
+    // The active profile
+    if (outLine == 0) {
+      printCRLF();
+      Serial.print(F("ACTIVE PROFILE:"));
+      printCRLF();
+    }
+    else
+      showProfile(cfg, outLine - 1);
+  }
+  else if (outSec <= eeProfNums) {
+    // The stored profiles, only the title if not valid
+    bool valid = profile.read(&cfgTemp, outSec - 1, false);
+    if (outLine == 0) {
+      printCRLF();
+      Serial.print(F("STORED PROFILE ")); Serial.print(outSec - 1); Serial.print(F(":"));
       printCRLF();
+    }
+    else if (valid)
+      showProfile(&cfgTemp, outLine - 1);
+  }
+  else {
+    // The stored phone numbers
+    if (outLine == 0) {
+      printCRLF();
+      Serial.print(F("TELEPHONE NUMBERS:"));
+      printCRLF();
+    }
+    else {
+      profile.pbGet(dn, outLine - 1);
+      Serial.print(outLine - 1); Serial.print(F("=")); Serial.print(dn);
+      printCRLF();
+    }
+  }
+  outLine++;
+  return true;
+}
+
+/**
+  Show the next line of the task statistics (AT%T0): the runs, the
+  average and the peak run time of each task, then the passes
+
+  @return false if there is nothing more to show
+*/
+bool HAYES::showTasks() {
+  if (outLine < sched.count) {
+    TASK_t *task = &sched.tasks[outLine];
+    print_P(task->name);
+    Serial.print(F(" RUN:")); Serial.print(task->runs);
+    Serial.print(F(" AVG:")); Serial.print(task->runs ? task->time / task->runs : 0);
+    Serial.print(F(" PEAK:")); Serial.print(task->peak);
+    printCRLF();
+  }
+  else if (outLine == sched.count) {
+    Serial.print(F("PASS:")); Serial.print(sched.passes);
+    Serial.print(F(" IDLE:")); Serial.print(sched.idle);
+    // The decimated input samples lost, the ISR being too slow
+    cli();
+    uint16_t lost = afskModem->ovsLost;
+    sei();
+    Serial.print(F(" DROP:")); Serial.print(lost);
+    printCRLF();
+  }
+  else
+    // All done
+    return false;
+  outLine++;
+  return true;
+}
+
+/**
+  Start a long command response, to be streamed by doOutput; its
+  command result is printed at the end
+
+  @param job the job (OUT_JOBS enum)
+*/
+void HAYES::outStart(uint8_t job) {
+  outJob    = job;
+  outLines  = 0;
+  outWait   = OFF;
+  outResult = RC_NONE;
+}
+
+/**
+  End the long command response, print its command result
+*/
+void HAYES::outEnd() {
+  outJob  = OUT_NONE;
+  outWait = OFF;
+  printResult(outResult);
+}
+
+/**
+  Check if a long command response is running
+
+  @return true if running
+*/
+bool HAYES::isBusy() {
+  return outJob != OUT_NONE;
+}
+
+/**
+  Check if the long command response can go on: there is room in the
+  serial TX buffer, or a key to go to the next page
+
+  @return true if doOutput has something to do
+*/
+bool HAYES::hasOutput() {
+  if (outJob == OUT_NONE)
+    return false;
+  if (outWait == ON)
+    return Serial.available();
+  return Serial.availableForWrite() >= HAYES_ROOM;
+}
+
+/**
+  Stream the next part of a long command response, not more than the
+  serial TX buffer can take, so that it never blocks
+*/
+void HAYES::doOutput() {
+  // Stop if no longer in command mode
+  if (afskModem->getMode() != COMMAND_MODE) {
+    outJob = OUT_NONE;
+    return;
+  }
+  // The end of the page, wait for a key
+  if (outWait == ON) {
+    char c = Serial.read();
+    // Clear the prompt
+    Serial.print(F("\r          \r"));
+    outWait  = OFF;
+    outLines = 0;
+    // Abort on 'Q', ESC or Ctrl-C
+    if (toupper(c) == 'Q' or c == 0x1B or c == 0x03)
+      this->outEnd();
+    return;
+  }
+#if HAYES_PAGE > 0
+  if (outLines >= HAYES_PAGE) {
+    Serial.print(F("-- MORE --"));
+    outWait = ON;
+    return;
+  }
+#endif
+  switch (outJob) {
+    case OUT_TEXT: {
+        // Print the text, as much as the serial TX buffer takes
+        uint8_t room = Serial.availableForWrite();
+        while (room--) {
+          char c = pgm_read_byte(outText);
+          if (c == '\0') {
+            this->outEnd();
+            break;
+          }
+          Serial.write(c);
+          outText++;
+#if HAYES_PAGE > 0
+          // Count the lines, stop at the end of the page
+          if (c == '\n' and ++outLines >= HAYES_PAGE)
+            break;
+#endif
+        }
+      }
+      break;
+    case OUT_CONFIG:
+      // Show the configuration, one line at a time
+      if (not this->showConfig())
+        this->outEnd();
+      break;
+    case OUT_TASKS:
+      // Show the task statistics, one task at a time
+      if (not this->showTasks())
+        this->outEnd();
+      break;
   }
 }
 
@@ -390,6 +614,9 @@ uint8_t HAYES::doSIO(uint8_t rcRemote) {
   char c;
   // Check if we just have to print a result
   if (rcRemote != RC_NONE) {
+    // Cut any long command response short, with its result
+    if (outJob != OUT_NONE)
+      this->outEnd();
     // Check for some special cases
     if (rcRemote == RC_NO_CARRIER) {
       // If NO CARRIER, show the call time
@@ -414,6 +641,24 @@ uint8_t HAYES::doSIO(uint8_t rcRemote) {
       // Print the command response
       printResult(cmdResult);
     }
+    else if (rcRemote == SIO_DIAL_DONE or rcRemote == SIO_DIAL_ABORT)
+      // Finish dialing and wait for the carrier, or print the result
+      printResult(dialEnd(rcRemote == SIO_DIAL_DONE));
+    else if (rcRemote == SIO_CAL_DONE or rcRemote == SIO_CAL_ABORT)
+      // Finish the calibration and print the result
+      printResult(calEnd(rcRemote == SIO_CAL_DONE));
+    else if (rcRemote == SIO_ESC_AT) {
+      // TIES escape: the command line starts with the "AT" already seen
+      buf[0] = 'A';
+      buf[1] = 'T';
+      len    = 2;
+      sChr   = '\0';
+      if (cfg->cmecho)
+        Serial.print(F("AT"));
+    }
+    else if (rcRemote == SIO_CD_ON or rcRemote == SIO_CD_OFF)
+      // Finish the answer or dial command and print its result
+      printResult(carrierEnd(rcRemote == SIO_CD_ON));
     else
       // Just print the remote result
       printResult(rcRemote);
@@ -533,6 +778,13 @@ void HAYES::doCommand() {
       cmdResult = RC_OK;
     // Process the line
     while (idx < strlen(buf)) {
+      // A streamed response (AT?, AT&V, AT%T0) must be the last command
+      // on the line, the next would print before it (its argument digits
+      // and the spaces are left over, skip them)
+      if (outJob != OUT_NONE and buf[idx] != ' ' and not isdigit(buf[idx])) {
+        cmdResult = RC_ERROR;
+        break;
+      }
       this->dispatch();
       if (cmdResult == RC_ERROR)
         break;
@@ -547,6 +799,11 @@ void HAYES::doCommand() {
   @param code the response code
 */
 void HAYES::printResult(uint8_t code, char* buf) {
+  // Keep the command result until the long response is over
+  if (outJob != OUT_NONE) {
+    outResult = code;
+    return;
+  }
   if (code != RC_NONE and cfg->quiet != 1)
     if (cfg->verbal) {
       printCRLF();
@@ -561,6 +818,29 @@ void HAYES::printResult(uint8_t code, char* buf) {
       Serial.print(code);
       printCRLF();
     }
+  // Change the DTE speed, if requested, after the result
+  this->setDTERate();
+}
+
+/**
+  Get the configured DTE serial speed
+
+  @return the speed (bps)
+*/
+uint32_t HAYES::getDTERate() {
+  return pgm_read_dword(&dteRates[cfg->dterte]);
+}
+
+/**
+  Set the serial port to the configured DTE speed, if it changed
+*/
+void HAYES::setDTERate() {
+  if (dteRate == cfg->dterte)
+    return;
+  dteRate = cfg->dterte;
+  // Let the serial output complete at the old speed
+  Serial.flush();
+  Serial.begin(this->getDTERate());
 }
 
 /**
@@ -577,8 +857,10 @@ void HAYES::dispatch() {
 
     // AT? Print the long help message, only for this syntax
     case '?':
-      if (idx == 3) {
-        print_P(atHelp, false);
+      if (idx == 3 and outJob == OUT_NONE) {
+        // Stream it from the main loop
+        outText = atHelp;
+        this->outStart(OUT_TEXT);
         cmdResult = RC_OK;
       }
       break;
@@ -594,22 +876,11 @@ void HAYES::dispatch() {
       afskModem->setLine(ON);
       // Phase 2: Answering carrier on (after a while)
       afskModem->setTxCarrier(ON);
-      // Phase 3: Wait for originating carrier for S7 seconds
-      if (afskModem->getRxCarrier()) {
-        // Phase 4: Data mode if carrier found
-        afskModem->setMode(DATA_MODE);
-        if (cfg->selcpm == 0)
-          cmdResult = RC_CONNECT;
-        else
-          cmdResult = RC_CONNECT_300;
-      }
-      else {
-        // No carrier, go offline
-        afskModem->setLine(OFF);
-        cmdResult = RC_NO_CARRIER;
-      }
-      // Disable result codes if ATQ2
-      if (cfg->quiet == 2) cmdResult = RC_NONE;
+      // Phase 3: Wait for originating carrier for S7 seconds, the result
+      // comes with the carrier detection (see carrierEnd)
+      afskModem->waitRxCarrier();
+      cdCommand = 'A';
+      cmdResult = RC_NONE;
       break;
 
     // ATB Select Communication Protocol
@@ -660,32 +931,10 @@ void HAYES::dispatch() {
         // Phase 3: Go online
         afskModem->setLine(ON);
         // Phase 4: Wait for dialtone / busy (NO_DIALTONE / BUSY)
-        // Phase 5: Dial: DTMF/Pulses
-        if (afskModem->dial(dialNumber)) {
-          // Phase 6: Wait for incoming carrier for S7 seconds
-          if (afskModem->getRxCarrier()) {
-            // Phase 7: Enable outgoing carrier
-            afskModem->setTxCarrier(ON);
-            // Phase 8: Enter data mode or stay in command mode
-            if (dialCmdMode)
-              cmdResult = RC_OK;
-            else {
-              afskModem->setMode(DATA_MODE);
-              if (cfg->selcpm == 0)
-                cmdResult = RC_CONNECT;
-              else
-                cmdResult = RC_CONNECT_300;
-            }
-          }
-          else {
-            // No carrier, go offline
-            afskModem->setLine(OFF);
-            cmdResult = RC_NO_CARRIER;
-          }
-        }
-        else
-          // Interrupted
-          cmdResult = RC_ERROR;
+        // Phase 5: Dial: DTMF/Pulses, the result comes with the end
+        // of dialing (see dialEnd)
+        afskModem->dial(dialNumber);
+        cmdResult = RC_NONE;
       }
       else
         // Invalid dial number
@@ -935,9 +1184,13 @@ void HAYES::dispatch() {
             cfg->dtropt = getValidDigit(0, 3, cfg->dtropt);
           break;
 
-        // AT&F Load factory defaults
-        case 'F':
-          cmdResult = profile.factory(cfg) ? RC_OK : RC_ERROR;
+        // AT&F Load factory defaults, but keep the DTE speed, not to
+        // lose the link
+        case 'F': {
+            uint8_t dterte = cfg->dterte;
+            cmdResult = profile.factory(cfg) ? RC_OK : RC_ERROR;
+            cfg->dterte = dterte;
+          }
           break;
 
         // AT&J Jack Type Selection (choose OCR2A or OCR2B)
@@ -1009,37 +1262,16 @@ void HAYES::dispatch() {
         // AT&V1  show stored profiles
         // AT&V2  show stored phone numbers
         case 'V':
-          // Show the active profile
-          if ((buf[idx] == '0') or (buf[idx] == '\0')) {
-            printCRLF();
-            Serial.print(F("ACTIVE PROFILE:"));
-            printCRLF();
-            showProfile(cfg);
-          }
-          // Show the stored profiles
-          if ((buf[idx] == '1') or (buf[idx] == '\0')) {
-            for (uint8_t slot = 0; slot < eeProfNums; slot++) {
-              struct CFG_t cfgTemp;
-              cmdResult = profile.read(&cfgTemp, slot, false) ? RC_OK : RC_ERROR;
-              printCRLF();
-              Serial.print(F("STORED PROFILE ")); Serial.print(slot); Serial.print(F(":"));
-              printCRLF();
-              if (cmdResult == RC_OK)
-                showProfile(&cfgTemp);
-            }
-          }
-          // Show the stored phone numbers
-          if ((buf[idx] == '2') or (buf[idx] == '\0')) {
-            char dn[eePhoneLen];
-            printCRLF();
-            Serial.print(F("TELEPHONE NUMBERS:"));
-            printCRLF();
-            for (uint8_t slot = 0; slot < eePhoneNums; slot++) {
-              profile.pbGet(dn, slot);
-              Serial.print(slot); Serial.print(F("=")); Serial.print(dn);
-              printCRLF();
-            }
+          if (outJob != OUT_NONE) {
+            cmdResult = RC_ERROR;
+            break;
           }
+          // Stream it from the main loop, one line at a time; the
+          // selection digit, if any, else everything
+          outSel  = isdigit(buf[idx]) ? buf[idx] : '\0';
+          outSec  = 0;
+          outLine = 0;
+          this->outStart(OUT_CONFIG);
           cmdResult = RC_OK;
           break;
 
@@ -1124,10 +1356,265 @@ void HAYES::dispatch() {
           cmdResult = RC_ERROR;
         break;
       }
+      // AT+IPR DTE serial speed
+      // AT+IPR?      show the current speed
+      // AT+IPR=?     list the supported speeds
+      // AT+IPR=n     set the speed to n bps
+      if (strncmp(&buf[idx], "IPR", 3) == 0) {
+        idx += 3;
+        if (buf[idx] == '?') {
+          idx += 1;
+          Serial.print(this->getDTERate());
+          printCRLF();
+          cmdResult = RC_OK;
+        }
+        else if (buf[idx] == '=' and buf[idx + 1] == '?') {
+          idx += 2;
+          Serial.print('(');
+          for (uint8_t i = 0; i < dteRatesNum; i++) {
+            if (i > 0) Serial.print(',');
+            Serial.print(pgm_read_dword(&dteRates[i]));
+          }
+          Serial.print(')');
+          printCRLF();
+          cmdResult = RC_OK;
+        }
+        else if (buf[idx] == '=') {
+          idx += 1;
+          // Get the speed
+          uint32_t rate = 0;
+          while (isdigit(buf[idx]))
+            rate = rate * 10 + (buf[idx++] - '0');
+          // Look it up, it applies after the result code
+          cmdResult = RC_ERROR;
+          for (uint8_t i = 0; i < dteRatesNum; i++)
+            if (rate == pgm_read_dword(&dteRates[i])) {
+              cfg->dterte = i;
+              cmdResult = RC_OK;
+            }
+        }
+        else
+          // Anything else is ERROR
+          cmdResult = RC_ERROR;
+        break;
+      }
+      // Any other is ERROR
+      cmdResult = RC_ERROR;
+      break;
+
+    // Diagnostic '%' extension
+    case '%':
+      switch (buf[idx++]) {
+        // AT%B Show the received data held in online command mode and lost
+        case 'B': {
+            cli();
+            uint16_t lost = afskModem->rxLost;
+            sei();
+            Serial.print(F("HELD:")); Serial.print(afskModem->spillLen());
+            Serial.print(F(" LOST:")); Serial.print(lost);
+          }
+          printCRLF();
+          cmdResult = RC_OK;
+          break;
+
+        // AT%C Sampling clock calibration
+        // AT%C0 show the CPU frequency correction (Hz)
+        // AT%C1 calibrate on the received carrier and store
+        // AT%C2 clear the stored correction, use the built-in one
+        case 'C':
+          option = getValidDigit(0, 2, 0);
+          // Nothing to do on a bad argument
+          if (cmdResult == RC_ERROR)
+            break;
+          switch (option) {
+            case 0:
+              Serial.print(F("COR:")); Serial.print(afskModem->fCor);
+              printCRLF();
+              break;
+            case 1:
+              // Measure for 10s, the result comes at the end (see calEnd)
+              cmdResult = afskModem->calStart(10) ? RC_NONE : RC_ERROR;
+              break;
+            case 2:
+              profile.corClear();
+              afskModem->setClock(F_COR);
+              break;
+          }
+          break;
+
+        // AT%F Show the frequency offset of the received tones (Hz)
+        case 'F':
+          Serial.print(F("OFS:")); Serial.print(afskModem->getFreqOffset());
+          printCRLF();
+          cmdResult = RC_OK;
+          break;
+
+        // AT%H Binary host control, until the exit frame, on-hook only
+        case 'H':
+          if (afskModem->getLine() == ON)
+            cmdResult = RC_ERROR;
+          else {
+            host.start();
+            cmdResult = RC_OK;
+          }
+          break;
+
+        // AT%L Show the RX line level, DC bias and AGC gain
+        case 'L':
+          Serial.print(F("LVL:")); Serial.print(afskModem->level);
+          Serial.print(F(" BIAS:")); Serial.print(afskModem->bias);
+          Serial.print(F(" GAIN:")); Serial.print(afskModem->gain);
+          printCRLF();
+          cmdResult = RC_OK;
+          break;
+
+        // AT%N Show the count of input samples blanked as impulse noise
+        case 'N':
+          Serial.print(F("BLK:")); Serial.print(afskModem->blanked);
+          printCRLF();
+          cmdResult = RC_OK;
+          break;
+
+        // AT%P Duty cycle
+        // AT%P0 show the time awake (%) and the count of power downs
+        // AT%P1 clear the statistics
+        case 'P':
+          option = getValidDigit(0, 1, 0);
+          // Nothing to do on a bad argument
+          if (cmdResult == RC_ERROR)
+            break;
+          switch (option) {
+            case 0: {
+                // Time awake, per mille, scaled down to avoid the overflow
+                uint32_t total = millis() - sched.start;
+                uint32_t slept = sched.sleepMs;
+                while (total > 4000000UL) {
+                  total >>= 1;
+                  slept >>= 1;
+                }
+                uint16_t duty = total ? 1000 - slept * 1000 / total : 1000;
+                Serial.print(F("DUTY:")); Serial.print(duty / 10);
+                Serial.print('.'); Serial.print(duty % 10);
+                Serial.print(F("% PWRDN:")); Serial.print(sched.pwrDowns);
+                printCRLF();
+              }
+              break;
+            case 1:
+              sched.clear();
+              break;
+          }
+          break;
+
+        // AT%T Task statistics
+        // AT%T0 show the runs, the average and the peak run time (us)
+        // AT%T1 clear the statistics
+        case 'T':
+          option = getValidDigit(0, 1, 0);
+          // Nothing to do on a bad argument
+          if (cmdResult == RC_ERROR)
+            break;
+          switch (option) {
+            case 0:
+              if (outJob != OUT_NONE) {
+                cmdResult = RC_ERROR;
+                break;
+              }
+              // Streamed by doOutput, one task at a time
+              outLine = 0;
+              this->outStart(OUT_TASKS);
+              break;
+            case 1:
+              sched.clear();
+              cli();
+              afskModem->ovsLost = 0;
+              sei();
+              break;
+          }
+          break;
+
+        default:
+          cmdResult = RC_ERROR;
+          break;
+      }
       break;
   }
 }
 
+/**
+  Finish the dial command, after dialing is over
+
+  @param done dialing completed, not interrupted
+  @return the result code
+*/
+uint8_t HAYES::dialEnd(bool done) {
+  uint8_t result;
+  if (done) {
+    // Phase 6: Wait for incoming carrier for S7 seconds, the result
+    // comes with the carrier detection (see carrierEnd)
+    afskModem->waitRxCarrier();
+    cdCommand = 'D';
+    result = RC_NONE;
+  }
+  else {
+    // Interrupted, go offline
+    afskModem->setLine(OFF);
+    result = RC_ERROR;
+  }
+  return result;
+}
+
+/**
+  Finish the sampling clock calibration (AT%C1): compute, store and show
+  the correction
+
+  @param done measured for the whole time, not interrupted
+  @return the result code
+*/
+uint8_t HAYES::calEnd(bool done) {
+  if (done and afskModem->calEnd()) {
+    profile.corSet(afskModem->fCor);
+    Serial.print(F("COR:")); Serial.print(afskModem->fCor);
+    printCRLF();
+    return RC_OK;
+  }
+  return RC_ERROR;
+}
+
+/**
+  Finish the answer or dial command, after waiting for the carrier
+
+  @param found the carrier has been detected
+  @return the result code
+*/
+uint8_t HAYES::carrierEnd(bool found) {
+  uint8_t result;
+  if (found) {
+    // Phase 7 (dial): Enable outgoing carrier
+    if (cdCommand == 'D')
+      afskModem->setTxCarrier(ON);
+    // Phase 8: Enter data mode or stay in command mode
+    if (cdCommand == 'D' and dialCmdMode)
+      result = RC_OK;
+    else {
+      afskModem->setMode(DATA_MODE);
+      if (cfg->selcpm == 0)
+        result = RC_CONNECT;
+      else
+        result = RC_CONNECT_300;
+    }
+  }
+  else {
+    // No carrier, go offline
+    afskModem->setLine(OFF);
+    result = RC_NO_CARRIER;
+  }
+  // Disable result codes for answering if ATQ2
+  if (cdCommand == 'A' and cfg->quiet == 2)
+    result = RC_NONE;
+  cdCommand = '\0';
+  return result;
+}
+
 /**
   Parse the line buffer and try to compose the dial number
 
@@ -1183,11 +1670,7 @@ bool HAYES::getDialNumber(char *dn, size_t len) {
       cfg->dialpt = OFF;
       idx++;
     }
-    else if (isdigit(buf[idx]) or
-             (buf[idx] >= 'A' and buf[idx] <= 'D') or
-             buf[idx] == '*' or
-             buf[idx] == '#' or
-             buf[idx] == ',') {
+    else if (profile.pbChar(buf[idx])) {
       // Digit or pause character
       dn[ndx++] = buf[idx++];
       // Check how many digits we have
@@ -32,6 +32,19 @@
 
 #include "config.h"
 #include "afsk.h"
+#include "sched.h"
+#include "host.h"
+
+// Lines per page of the long command responses (0 to disable paging)
+#ifndef HAYES_PAGE
+#define HAYES_PAGE 0
+#endif
+
+// Room in the serial TX buffer for one step of the long responses
+#define HAYES_ROOM 48
+
+// Long command responses, streamed by doOutput
+enum OUT_JOBS {OUT_NONE, OUT_TEXT, OUT_CONFIG, OUT_TASKS};
 
 // Result codes
 enum RESULT_CODES {RC_OK, RC_CONNECT, RC_RING, RC_NO_CARRIER, RC_ERROR,
@@ -120,7 +133,7 @@ const char atHelp[] PROGMEM = {"AT-Commands\r\n"
                                " AT&D1 return to command mode after losing DTR\r\n"
                                " AT&D2 hang up, turn off auto answer, return to command mode after losing DTR\r\n"
                                " AT&D3 reset after losing DTR\r\n"
-                               "AT&F Load factory defaults\r\n"
+                               "AT&F Load factory defaults, except the DTE serial speed (AT+IPR)\r\n"
                                "AT&J Jack Type Selection (choose OCR2A or OCR2B)\r\n"
                                " AT&J0 OCR2A primary, OCR2B secondary\r\n"
                                " AT&J1 OCR2A secondary, OCR2B primary\r\n"
@@ -158,6 +171,27 @@ const char atHelp[] PROGMEM = {"AT-Commands\r\n"
                                " AT+FCLASS? show current device mode\r\n"
                                " AT+FCLASS=? list the supported device modes\r\n"
                                " AT+FCLASS=0 set the device mode to data\r\n"
+                               "AT+IPR DTE serial speed, applied after the result code\r\n"
+                               " AT+IPR? show the current speed\r\n"
+                               " AT+IPR=? list the supported speeds\r\n"
+                               " AT+IPR=n set the speed to n bps (300 to 115200)\r\n"
+                               "\r\n"
+                               "AT%B Show the received bytes held in online command mode, and lost\r\n"
+                               "AT%C Sampling clock calibration\r\n"
+                               " AT%C0 show the CPU frequency correction (Hz)\r\n"
+                               " AT%C1 calibrate on the received carrier (idle far end, 10s) and store\r\n"
+                               " AT%C2 clear the stored correction\r\n"
+                               "AT%F Show the frequency offset of the received tones (Hz)\r\n"
+                               "AT%H Binary host control (on-hook), until the exit frame, see host.h\r\n"
+                               "AT%L Show the RX line level, DC bias and AGC gain (x256)\r\n"
+                               "AT%N Show the count of input samples blanked as impulse noise\r\n"
+                               "AT%P Duty cycle\r\n"
+                               " AT%P0 show the time awake (%) and the count of power downs\r\n"
+                               " AT%P1 clear the statistics\r\n"
+                               "AT%T Task statistics\r\n"
+                               " AT%T0 show the runs, the average and the peak run time (us) of each task,\r\n"
+                               "       the scheduler passes and the input samples dropped\r\n"
+                               " AT%T1 clear the statistics\r\n"
                                "\r\n"
                                "\r\n"
                                "SReg  Description\r\n"
@@ -174,7 +208,7 @@ const char atHelp[] PROGMEM = {"AT-Commands\r\n"
                                "  10  Carrier Loss Disconnect Time (tenths of a second)\r\n"
                                "  11  DTMF Tone Duration\r\n"
                                "  12  Escape Prompt Delay\r\n"
-                               "  13  Reserved\r\n"
+                               "  13  Escape Options (1: +++AT<CR> without guard time, 2: BREAK, 4: none)\r\n"
                                "  14  General Bit Mapped Options Status\r\n"
                                "  15  Reserved\r\n"
                               };
@@ -200,6 +234,13 @@ class HAYES {
     int8_t  getValidDigit(int8_t low, int8_t hgh, int8_t def = HAYES_NUM_ERROR);
 
 
+    uint32_t getDTERate();
+    void    setDTERate();
+
+    bool    hasOutput();
+    void    doOutput();
+    bool    isBusy();
+
     uint8_t doSIO(uint8_t rcRemote = RC_NONE);
     void    doCommand();
     void    dispatch();
@@ -227,6 +268,9 @@ class HAYES {
     // The result status of the last command
     uint8_t cmdResult = RC_OK;
 
+    // The DTE serial speed in use (index in dteRates)
+    uint8_t dteRate = 0xFF;
+
     void    cmdPrint(char cmd, uint8_t value, bool newline = true);
     void    cmdPrint(char cmd, char mod, uint8_t value, bool newline = true);
     void    cmdPrint(uint8_t value);
@@ -237,9 +281,28 @@ class HAYES {
     uint8_t dialReverse = 0;
     char    dialNumber[eePhoneLen];
     bool    getDialNumber(char *dn, size_t len);
+    uint8_t dialEnd(bool done);
+    uint8_t carrierEnd(bool found);
+    uint8_t calEnd(bool done);
+    // The command waiting for the carrier, 'A' or 'D'
+    char    cdCommand = '\0';
+
 
+    void    showProfile(CFG_t *conf, uint8_t line);
+    bool    showConfig();
+    bool    showTasks();
 
-    void    showProfile(CFG_t *conf);
+    // Long command responses
+    uint8_t outJob    = OUT_NONE; // The running job (OUT_JOBS enum)
+    const char *outText;          // The text left to print (PROGMEM)
+    char    outSel;               // AT&V selection
+    uint8_t outSec;               // AT&V section
+    uint8_t outLine;              // AT&V line in section, AT%T task
+    uint8_t outLines  = 0;        // Lines printed on this page
+    uint8_t outWait   = OFF;      // At the end of the page, waiting for a key
+    uint8_t outResult = RC_NONE;  // The command result, printed at the end
+    void    outStart(uint8_t job);
+    void    outEnd();
 
 };
 
@@ -0,0 +1,328 @@
+/**
+  host.cpp - Binary host control protocol
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "host.h"
+
+// The profile storage (hayes.cpp)
+extern Profile profile;
+
+// The host control
+HOST host;
+
+HOST::HOST() {
+}
+
+HOST::~HOST() {
+}
+
+/**
+  Set the configuration and the modem to work on
+
+  @param conf the configuration structure
+  @param afsk the modem
+*/
+void HOST::init(CFG_t *conf, AFSK *afsk) {
+  this->cfg = conf;
+  this->afskModem = afsk;
+}
+
+/**
+  Start the host control, the serial input is read as frames
+*/
+void HOST::start() {
+  pos    = 0;
+  skip   = OFF;
+  active = ON;
+}
+
+/**
+  Check if the host control is running
+
+  @return true if the serial input is read as frames
+*/
+bool HOST::isActive() {
+  return active == ON;
+}
+
+/**
+  Read the serial input, execute the frame when complete
+
+  @return RC_OK after the exit frame, or SIO_NONE
+*/
+uint8_t HOST::doSIO() {
+  while (Serial.available()) {
+    uint8_t c = Serial.read();
+    uint32_t now = millis();
+    // Drop the incomplete frame after a pause
+    if ((pos > 0 or skip == ON) and now - last > HOST_TIMEOUT) {
+      pos  = 0;
+      skip = OFF;
+    }
+    last = now;
+    // Dropping the input until a pause
+    if (skip == ON)
+      continue;
+    // Check the length first
+    if (pos == 0 and c > HOST_MAX) {
+      this->nak(HOST_NAK, HOST_ERR_LEN);
+      skip = ON;
+      continue;
+    }
+    frm[pos++] = c;
+    // Execute the frame when complete
+    if (pos == frm[0] + 3) {
+      pos = 0;
+      return this->exec();
+    }
+  }
+  return SIO_NONE;
+}
+
+/**
+  Send a result code as an unsolicited frame
+
+  @param code the result code
+*/
+void HOST::doEvent(uint8_t code) {
+  this->reply(HOST_EVENT, &code, 1);
+}
+
+/**
+  Check and execute the received frame, send the reply
+
+  @return RC_OK after the exit frame, or SIO_NONE
+*/
+uint8_t HOST::exec() {
+  uint8_t len = frm[0];
+  uint8_t op  = frm[1];
+  uint8_t *pld = &frm[2];
+  uint8_t err = 0;
+  // Check the CRC
+  uint8_t crc8 = 0;
+  for (uint8_t i = 0; i < len + 2; i++)
+    crc8 = profile.CRC8(crc8, frm[i]);
+  if (crc8 != frm[len + 2]) {
+    this->nak(op, HOST_ERR_CRC);
+    return SIO_NONE;
+  }
+
+  switch (op) {
+    // Echo the payload
+    case HOST_NOP:
+      this->reply(op, pld, len);
+      break;
+
+    // Back to the AT commands
+    case HOST_EXIT:
+      this->reply(op, NULL, 0);
+      active = OFF;
+      // RC_OK
+      return 0;
+
+    // Read the active profile
+    case HOST_CFG_GET:
+      this->reply(op, cfg->data, eeProfLen);
+      break;
+
+    // Write the active profile, checked as AT&Y does, crc8 included
+    case HOST_CFG_SET:
+      if (len != eeProfLen)
+        err = HOST_ERR_LEN;
+      else if (not profile.valid((CFG_t*)pld))
+        err = HOST_ERR_ARG;
+      else {
+        memcpy(cfg->data, pld, eeProfLen);
+        this->reply(op, NULL, 0);
+      }
+      break;
+
+    // Read S registers: first, count
+    case HOST_SREG_GET:
+      if (len != 2)
+        err = HOST_ERR_LEN;
+      else if (pld[0] + pld[1] > 16)
+        err = HOST_ERR_ARG;
+      else {
+        uint8_t regs[17];
+        regs[0] = pld[0];
+        for (uint8_t i = 0; i < pld[1]; i++)
+          regs[i + 1] = profile.sregGet(cfg, pld[0] + i);
+        this->reply(op, regs, pld[1] + 1);
+      }
+      break;
+
+    // Write S registers: first, values
+    case HOST_SREG_SET:
+      if (len < 1)
+        err = HOST_ERR_LEN;
+      else if (pld[0] + len - 1 > 16)
+        err = HOST_ERR_ARG;
+      else {
+        for (uint8_t i = 1; i < len; i++)
+          profile.sregSet(cfg, pld[0] + i - 1, pld[i]);
+        this->reply(op, NULL, 0);
+      }
+      break;
+
+    // Read a phone number: slot
+    case HOST_PB_GET:
+      if (len != 1)
+        err = HOST_ERR_LEN;
+      else if (pld[0] >= eePhoneNums)
+        err = HOST_ERR_ARG;
+      else {
+        char dn[eePhoneLen + 2];
+        memset(dn, 0, sizeof(dn));
+        dn[0] = pld[0];
+        profile.pbGet(&dn[1], pld[0]);
+        this->reply(op, dn, strlen(&dn[1]) + 1);
+      }
+      break;
+
+    // Write a phone number: slot, number (the chars AT&Z takes, and
+    // room left for the terminator)
+    case HOST_PB_SET:
+      if (len < 1 or len > eePhoneLen)
+        err = HOST_ERR_LEN;
+      else if (pld[0] >= eePhoneNums)
+        err = HOST_ERR_ARG;
+      else {
+        for (uint8_t i = 1; i < len; i++)
+          if (not profile.pbChar(pld[i]))
+            err = HOST_ERR_ARG;
+      }
+      if (err == 0) {
+        char dn[eePhoneLen];
+        memset(dn, 0, sizeof(dn));
+        memcpy(dn, &pld[1], len - 1);
+        profile.pbSet(dn, pld[0]);
+        this->reply(op, NULL, 0);
+      }
+      break;
+
+    // Store the active profile: slot
+    case HOST_PRF_WR:
+    // Load a stored profile: slot
+    case HOST_PRF_RD:
+      if (len != 1)
+        err = HOST_ERR_LEN;
+      else if (pld[0] >= eeProfNums)
+        err = HOST_ERR_ARG;
+      else if (op == HOST_PRF_WR ? profile.write(cfg, pld[0]) : profile.read(cfg, pld[0], false))
+        this->reply(op, NULL, 0);
+      else
+        err = HOST_ERR_EE;
+      break;
+
+    // Read the modem statistics
+    case HOST_STATS:
+      if (len != 0)
+        err = HOST_ERR_LEN;
+      else {
+        HSTATS_t st;
+        st.uptime   = millis();
+        st.start    = sched.start;
+        st.passes   = sched.passes;
+        st.idle     = sched.idle;
+        st.sleepMs  = sched.sleepMs;
+        st.pwrDowns = sched.pwrDowns;
+        cli();
+        st.rxLost   = afskModem->rxLost;
+        st.ovsLost  = afskModem->ovsLost;
+        sei();
+        st.held     = afskModem->spillLen();
+        st.blanked  = afskModem->blanked;
+        st.level    = afskModem->level;
+        st.bias     = afskModem->bias;
+        st.gain     = afskModem->gain;
+        st.ofs      = afskModem->getFreqOffset();
+        st.fCor     = afskModem->fCor;
+        this->reply(op, &st, sizeof(st));
+      }
+      break;
+
+    // Read the task statistics: index, reply runs, total and peak
+    // run time (us), then the name
+    case HOST_TASK:
+      if (len != 1)
+        err = HOST_ERR_LEN;
+      else if (pld[0] >= sched.count)
+        err = HOST_ERR_ARG;
+      else {
+        TASK_t *task = &sched.tasks[pld[0]];
+        uint8_t data[HOST_MAX];
+        memcpy(&data[0], &task->runs, 4);
+        memcpy(&data[4], &task->time, 4);
+        memcpy(&data[8], &task->peak, 2);
+        strncpy_P((char*)&data[10], task->name, HOST_MAX - 10);
+        this->reply(op, data, 10 + strnlen((char*)&data[10], HOST_MAX - 10));
+      }
+      break;
+
+    // Clear the scheduler statistics and the dropped samples
+    case HOST_CLEAR:
+      sched.clear();
+      cli();
+      afskModem->ovsLost = 0;
+      sei();
+      this->reply(op, NULL, 0);
+      break;
+
+    default:
+      err = HOST_ERR_OP;
+      break;
+  }
+  // Report the error
+  if (err)
+    this->nak(op, err);
+  return SIO_NONE;
+}
+
+/**
+  Send a frame
+
+  @param op the operation code, HOST_REPLY is set for the replies
+  @param data the payload
+  @param len the payload length
+*/
+void HOST::reply(uint8_t op, const void *data, uint8_t len) {
+  // The replies have the high bit set, the events and errors already do
+  if (op < HOST_REPLY)
+    op |= HOST_REPLY;
+  uint8_t crc8 = profile.CRC8(profile.CRC8(0, len), op);
+  Serial.write(len);
+  Serial.write(op);
+  for (uint8_t i = 0; i < len; i++) {
+    uint8_t c = ((const uint8_t*)data)[i];
+    crc8 = profile.CRC8(crc8, c);
+    Serial.write(c);
+  }
+  Serial.write(crc8);
+}
+
+/**
+  Send an error frame
+
+  @param op the operation code in error
+  @param err the error code (HOST_ERRORS enum)
+*/
+void HOST::nak(uint8_t op, uint8_t err) {
+  uint8_t data[2] = {op, err};
+  this->reply(HOST_NAK, data, 2);
+}
@@ -0,0 +1,116 @@
+/**
+  host.h - Binary host control protocol
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HOST_H
+#define HOST_H
+
+#include <Arduino.h>
+
+#include "config.h"
+#include "afsk.h"
+#include "sched.h"
+
+/*
+  Entered with AT%H (on-hook only), left with the EXIT frame, then OK.
+  Each frame, both ways:
+
+    LEN  OP  PAYLOAD (LEN bytes)  CRC8 (of LEN, OP and PAYLOAD)
+
+  The replies carry the operation code with HOST_REPLY set, the errors
+  come as NAK frames.  The multi-byte values are little endian.  A frame
+  not complete after HOST_TIMEOUT is dropped.
+*/
+
+// Maximum payload length of a frame
+#define HOST_MAX      40
+// Drop the incomplete frame after this time (ms)
+#define HOST_TIMEOUT  100
+// The replies have this bit set in the operation code
+#define HOST_REPLY    0x80
+
+// Host control operations
+enum HOST_OPS {HOST_NOP      = 0x00,  // Echo the payload
+               HOST_EXIT     = 0x01,  // Back to the AT commands
+               HOST_CFG_GET  = 0x10,  // Read the active profile (CFG_t)
+               HOST_CFG_SET  = 0x11,  // Write the active profile (CFG_t, with its crc8)
+               HOST_SREG_GET = 0x12,  // Read S registers: first, count
+               HOST_SREG_SET = 0x13,  // Write S registers: first, values
+               HOST_PB_GET   = 0x14,  // Read a phone number: slot
+               HOST_PB_SET   = 0x15,  // Write a phone number: slot, number (31 chars)
+               HOST_PRF_WR   = 0x16,  // Store the active profile: slot (AT&W)
+               HOST_PRF_RD   = 0x17,  // Load a stored profile: slot (AT&Y)
+               HOST_STATS    = 0x20,  // Read the modem statistics (HSTATS_t)
+               HOST_TASK     = 0x21,  // Read the task statistics: index
+               HOST_CLEAR    = 0x22,  // Clear the scheduler statistics and the dropped samples
+               HOST_EVENT    = 0xFE,  // Unsolicited result code (RING)
+               HOST_NAK      = 0xFF   // Error: operation, error code
+              };
+
+// Host control errors
+enum HOST_ERRORS {HOST_ERR_CRC = 1, HOST_ERR_OP, HOST_ERR_LEN, HOST_ERR_ARG, HOST_ERR_EE};
+
+// The modem statistics, HOST_STATS reply
+struct HSTATS_t {
+  uint32_t uptime;    // Time since reset (ms)
+  uint32_t start;     // Start of the scheduler statistics (ms)
+  uint32_t passes;    // Scheduler passes ...
+  uint32_t idle;      // ... and those with no task run
+  uint32_t sleepMs;   // Time asleep (ms)
+  uint16_t pwrDowns;  // Count of power downs
+  uint16_t rxLost;    // Received bytes lost
+  uint16_t held;      // Received bytes held in online command mode
+  uint16_t blanked;   // Input samples blanked as impulse noise
+  uint8_t  level;     // RX line level
+  uint8_t  bias;      // RX DC bias
+  uint16_t gain;      // AGC gain (Q8)
+  int16_t  ofs;       // Frequency offset of the received tones (Hz)
+  int32_t  fCor;      // CPU frequency correction (Hz)
+  uint16_t ovsLost;   // Decimated input samples dropped (ADC_OVS)
+};
+
+class HOST {
+  public:
+    HOST();
+    ~HOST();
+
+    void    init(CFG_t *conf, AFSK *afsk);
+    void    start();
+    bool    isActive();
+    uint8_t doSIO();
+    void    doEvent(uint8_t code);
+
+  private:
+    CFG_t *cfg;
+    AFSK  *afskModem;
+
+    uint8_t  active = OFF;      // Host control running
+    uint8_t  frm[HOST_MAX + 3]; // The frame being received
+    uint8_t  pos    = 0;        // Bytes received in frame
+    uint8_t  skip   = OFF;      // Drop the input until a pause
+    uint32_t last   = 0;        // Time of the last byte received
+
+    uint8_t exec();
+    void    reply(uint8_t op, const void *data, uint8_t len);
+    void    nak(uint8_t op, uint8_t err);
+};
+
+// The host control
+extern HOST host;
+
+#endif /* HOST_H */
@@ -29,6 +29,45 @@
 // RX/TX debug
 //#define DEBUG_RX_LVL
 
+// ISR load debug (CPU cycles per sample, only with ADC_OVS 1)
+//#define DEBUG_CYCLES
+
+// Echo canceller taps (at most 32, 0 to disable)
+//#define EC_TAPS 8
+
+// Keep the full sine wave table in SRAM (256 bytes) instead of flash
+//#define WAVE_SRAM
+
+// Wave phase accumulator bits: 16 (within 0.07Hz) or 32 (exact tones)
+//#define WAVE_PHASE_BITS 32
+
+// TX noise shaping, pushing the DAC quantization noise out of the RX band
+//#define TX_NOISE_SHAPING
+
+// TX mark/space transitions as raised cosine ramps over this many samples
+//#define TX_RAMP 8
+
+// Sampling frequency (9600 or, for a lighter RX load, 7200)
+//#define F_SAMPLE 7200
+
+// ADC oversampling ratio, the input is decimated to F_SAMPLE (2 or 4)
+//#define ADC_OVS 4
+
+// Buffer for the data received in online command mode, replayed on ATO,
+// in bits: 4 (16 bytes) to 7 (128 bytes)
+//#define SPILL_BITS 6
+
+// Lines per page of the long command responses (AT?, AT&V), then wait
+// for a key ('Q', ESC or Ctrl-C stop)
+//#define HAYES_PAGE 24
+
+// FIFOs size, in bits: 4 (16 bytes) to 7 (128 bytes)
+//#define FIFO_BITS 5
+
+// Power down after this many seconds idle, on-hook; RING, DTR or the
+// serial input wake the modem up, but the first serial char is lost
+//#define PWR_DOWN 60
+
 // CPU frequency correction for sampling timer
 #define F_COR (0L)
 
@@ -0,0 +1,174 @@
+/**
+  sched.cpp - Cooperative task scheduler
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sched.h"
+
+// The scheduler
+SCHED sched;
+
+SCHED::SCHED() {
+}
+
+SCHED::~SCHED() {
+}
+
+/**
+  Add a timer driven task, run each period
+
+  @param name the task name (PROGMEM)
+  @param func the task function
+  @param period the task period (ms)
+  @return the task index, or 0xFF if no more room
+*/
+uint8_t SCHED::add(const char *name, task_f func, uint16_t period) {
+  if (count >= SCHED_TASKS)
+    return 0xFF;
+  TASK_t *task = &tasks[count];
+  memset(task, 0, sizeof(TASK_t));
+  task->name    = name;
+  task->func    = func;
+  task->period  = period;
+  task->next    = millis() + period;
+  return count++;
+}
+
+/**
+  Add an event driven task, run only when its event check says so
+
+  @param name the task name (PROGMEM)
+  @param func the task function
+  @param event the event check function
+  @return the task index, or 0xFF if no more room
+*/
+uint8_t SCHED::add(const char *name, task_f func, event_f event) {
+  if (count >= SCHED_TASKS)
+    return 0xFF;
+  TASK_t *task = &tasks[count];
+  memset(task, 0, sizeof(TASK_t));
+  task->name    = name;
+  task->func    = func;
+  task->event   = event;
+  return count++;
+}
+
+/**
+  One pass through all tasks, in order, running those which are due:
+  the timer driven ones when their period has elapsed, the event driven
+  ones when they have work to do.
+
+  @return true if any task has run
+*/
+bool SCHED::run() {
+  bool busy = false;
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < count; i++) {
+    TASK_t *task = &tasks[i];
+    if (task->event != NULL) {
+      // Event driven task
+      if (not task->event())
+        continue;
+    }
+    else {
+      // Timer driven task, keep the cadence
+      if ((int32_t)(now - task->next) < 0)
+        continue;
+      task->next += task->period;
+      // Do not try to catch up after a long stall
+      if ((int32_t)(now - task->next) >= 0)
+        task->next = now + task->period;
+    }
+    this->exec(task);
+    busy = true;
+  }
+  // Count the passes
+  passes++;
+  if (not busy)
+    idle++;
+  return busy;
+}
+
+/**
+  Run the task and keep its statistics
+
+  @param task the task to run
+*/
+void SCHED::exec(TASK_t *task) {
+  uint32_t start = micros();
+  task->func();
+  uint32_t time = micros() - start;
+  task->runs++;
+  task->time += time;
+  if (time > task->peak)
+    task->peak = time > 0xFFFF ? 0xFFFF : time;
+}
+
+/**
+  Sleep until the next interrupt, in idle mode (the timers, the ADC and
+  the USART keep running) and count the time asleep.  If the sample ISR
+  woke us, its run time is not counted.
+*/
+void SCHED::sleep() {
+  uint32_t start = micros();
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  cli();
+  asleep = true;
+  sleep_enable();
+  // The next instruction after sei is executed before any interrupt
+  sei();
+  sleep_cpu();
+  sleep_disable();
+  // Get the wake up time
+  cli();
+  uint32_t stop = asleep ? micros() : woke;
+  asleep = false;
+  sei();
+  // Count the time asleep
+  sleepUs += stop - start;
+  while (sleepUs >= 1000) {
+    sleepUs -= 1000;
+    sleepMs++;
+  }
+}
+
+/**
+  Keep the wake up time, called first thing by the sample ISR
+*/
+void SCHED::wake() {
+  if (asleep) {
+    woke = micros();
+    asleep = false;
+  }
+}
+
+/**
+  Clear the statistics
+*/
+void SCHED::clear() {
+  for (uint8_t i = 0; i < count; i++) {
+    tasks[i].runs = 0;
+    tasks[i].time = 0;
+    tasks[i].peak = 0;
+  }
+  passes   = 0;
+  idle     = 0;
+  start    = millis();
+  sleepMs  = 0;
+  sleepUs  = 0;
+  pwrDowns = 0;
+}
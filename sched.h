@@ -0,0 +1,77 @@
+/**
+  sched.h - Cooperative task scheduler
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <Arduino.h>
+#include <avr/sleep.h>
+
+// Maximum number of tasks
+#define SCHED_TASKS 10
+
+// Task function
+typedef void (*task_f)();
+// Event check function, true if the task has work to do
+typedef bool (*event_f)();
+
+// Task related data
+struct TASK_t {
+  const char *name;   // Task name (PROGMEM)
+  task_f    func;     // Task function
+  event_f   event;    // Event check, for event driven tasks
+  uint16_t  period;   // Period (ms), for timer driven tasks
+  uint32_t  next;     // Next run (ms), for timer driven tasks
+  uint32_t  runs;     // Count of runs
+  uint32_t  time;     // Total run time (us)
+  uint16_t  peak;     // Maximum run time (us)
+};
+
+class SCHED {
+  public:
+    SCHED();
+    ~SCHED();
+
+    uint8_t add(const char *name, task_f func, uint16_t period);
+    uint8_t add(const char *name, task_f func, event_f event);
+    bool    run();
+    void    sleep();
+    void    wake();
+    void    clear();
+
+    uint8_t count = 0;          // Count of tasks
+    TASK_t  tasks[SCHED_TASKS]; // The tasks, in order of priority
+    uint32_t passes = 0;        // Count of passes through all tasks
+    uint32_t idle   = 0;        // Count of passes with no task run
+    uint32_t start  = 0;        // Start of the statistics (ms)
+    uint32_t sleepMs = 0;       // Time asleep (ms) ...
+    uint16_t sleepUs = 0;       // ... and the rest (us)
+    uint16_t pwrDowns = 0;      // Count of power downs
+
+  private:
+    void    exec(TASK_t *task);
+
+    volatile uint8_t  asleep = false; // Sleeping, not yet woken up by the sample ISR
+    volatile uint32_t woke   = 0;     // Wake up time, as seen by the sample ISR (us)
+};
+
+// The scheduler
+extern SCHED sched;
+
+#endif /* SCHED_H */
@@ -0,0 +1,118 @@
+/**
+  Arduino.h - The Arduino core, as far as the modem uses it, for the host
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <math.h>
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/interrupt.h>
+
+#define F_CPU 16000000UL
+
+#define PI      3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI  6.283185307179586476925286766559
+
+// The AVR core math macros
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define abs(x) ((x) > 0 ? (x) : -(x))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+// Time, as simulated by the host program
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+// Flash strings are plain strings here
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper*)(s))
+
+// The serial port, its input and output provided by the host program
+class HardwareSerial {
+  public:
+    void   begin(unsigned long) {}
+    void   end() {}
+    int    available();
+    int    availableForWrite() {
+      return 63;
+    }
+    int    peek();
+    int    read();
+    void   flush() {}
+    size_t write(uint8_t c);
+    size_t write(const char *s) {
+      size_t n = 0;
+      while (*s) n += write((uint8_t)*s++);
+      return n;
+    }
+    size_t print(const char *s) {
+      return write(s);
+    }
+    size_t print(const __FlashStringHelper *s) {
+      return write((const char*)s);
+    }
+    size_t print(char c) {
+      return write((uint8_t)c);
+    }
+    size_t print(long v) {
+      char b[12];
+      snprintf(b, sizeof(b), "%ld", v);
+      return write(b);
+    }
+    size_t print(unsigned long v) {
+      char b[12];
+      snprintf(b, sizeof(b), "%lu", v);
+      return write(b);
+    }
+    size_t print(int v) {
+      return print((long)v);
+    }
+    size_t print(unsigned int v) {
+      return print((unsigned long)v);
+    }
+    size_t print(unsigned char v) {
+      return print((unsigned long)v);
+    }
+    template <typename T> size_t println(T v) {
+      return print(v) + println();
+    }
+    size_t println() {
+      return write("\r\n");
+    }
+    operator bool() {
+      return true;
+    }
+};
+
+extern HardwareSerial Serial;
+
+#endif /* ARDUINO_H */
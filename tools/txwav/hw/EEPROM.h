@@ -0,0 +1,55 @@
+/**
+  EEPROM.h - The EEPROM, in host memory
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include <stdint.h>
+#include <string.h>
+
+class EEPROMClass {
+  public:
+    EEPROMClass() {
+      memset(mem, 0xFF, sizeof(mem));
+    }
+    uint8_t read(int idx) {
+      return mem[idx];
+    }
+    void write(int idx, uint8_t val) {
+      mem[idx] = val;
+    }
+    void update(int idx, uint8_t val) {
+      mem[idx] = val;
+    }
+    template <typename T> T &get(int idx, T &t) {
+      memcpy(&t, &mem[idx], sizeof(T));
+      return t;
+    }
+    template <typename T> const T &put(int idx, const T &t) {
+      memcpy(&mem[idx], &t, sizeof(T));
+      return t;
+    }
+
+  private:
+    uint8_t mem[E2END + 1];
+};
+
+extern EEPROMClass EEPROM;
+
+#endif /* EEPROM_H */
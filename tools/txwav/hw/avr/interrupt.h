@@ -0,0 +1,28 @@
+/**
+  avr/interrupt.h - No interrupts on the host, the program calls the handlers
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AVR_INTERRUPT_H
+#define AVR_INTERRUPT_H
+
+#define ISR(vector) void vector(void)
+
+static inline void cli() {}
+static inline void sei() {}
+
+#endif /* AVR_INTERRUPT_H */
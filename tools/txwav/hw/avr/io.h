@@ -0,0 +1,65 @@
+/**
+  avr/io.h - The ATmega328P registers, as plain variables
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AVR_IO_H
+#define AVR_IO_H
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+#define _SFR_BYTE(sfr) (sfr)
+
+#define E2END 0x3FF
+
+// The registers, defined by the host program
+#define REG8(r)  extern volatile uint8_t  r;
+#define REG16(r) extern volatile uint16_t r;
+REG8(ADCH)   REG8(ADCL)   REG8(ADCSRA) REG8(ADCSRB) REG8(ADMUX)  REG8(DIDR0)
+REG8(ASSR)   REG8(TCCR1A) REG8(TCCR1B) REG8(TCCR2A) REG8(TCCR2B) REG8(TIMSK0)
+REG8(TIMSK1) REG8(TIFR1)  REG8(OCR2A)  REG8(OCR2B)  REG16(ICR1)  REG16(TCNT1)
+REG8(DDRB)   REG8(DDRC)   REG8(DDRD)   REG8(PORTB)  REG8(PORTC)  REG8(PORTD)
+REG8(PINB)   REG8(PIND)   REG8(EICRA)  REG8(EIMSK)  REG8(EIFR)   REG8(PCICR)
+REG8(PCMSK2) REG8(PCIFR)  REG8(SMCR)   REG8(MCUCR)  REG8(PRR)
+#undef REG8
+#undef REG16
+
+// The register bits
+enum {ADPS0 = 0, ADPS1, ADPS2, ADIE, ADIF, ADATE, ADSC, ADEN};
+enum {ADTS0 = 0, ADTS1, ADTS2};
+enum {MUX0 = 0, MUX1, MUX2, MUX3, ADLAR = 5, REFS0, REFS1};
+enum {CS10 = 0, CS11, CS12, WGM12, WGM13, ICES1 = 6, ICNC1};
+enum {ICF1 = 5};
+enum {WGM20 = 0, WGM21, COM2B0 = 4, COM2B1, COM2A0, COM2A1};
+enum {CS20 = 0, CS21, CS22, WGM22};
+enum {TCR2BUB = 0, TCR2AUB, OCR2BUB, OCR2AUB, TCN2UB, AS2, EXCLK};
+enum {TOIE0 = 0, OCIE0A, OCIE0B};
+enum {TOIE1 = 0, OCIE1A, OCIE1B, ICIE1 = 5};
+enum {ISC00 = 0, ISC01, ISC10, ISC11};
+enum {INT0 = 0, INT1};
+enum {INTF0 = 0, INTF1};
+enum {PCIE0 = 0, PCIE1, PCIE2};
+enum {PCIF0 = 0, PCIF1, PCIF2};
+enum {PCINT16 = 0, PCINT17, PCINT18, PCINT19, PCINT20, PCINT21, PCINT22, PCINT23};
+enum {PORTB0 = 0, PORTB1, PORTB2, PORTB3, PORTB4, PORTB5, PORTB6, PORTB7};
+enum {PORTC0 = 0, PORTC1, PORTC2, PORTC3, PORTC4, PORTC5, PORTC6};
+enum {PORTD0 = 0, PORTD1, PORTD2, PORTD3, PORTD4, PORTD5, PORTD6, PORTD7};
+enum {PIND0 = 0, PIND1, PIND2, PIND3, PIND4, PIND5, PIND6, PIND7};
+enum {PRADC = 0, PRUSART0, PRSPI, PRTIM1, PRTIM0 = 5, PRTIM2, PRTWI};
+
+#endif /* AVR_IO_H */
@@ -0,0 +1,46 @@
+/**
+  avr/pgmspace.h - The program memory is the data memory on the host
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AVR_PGMSPACE_H
+#define AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+#define pgm_read_byte(p)  (*(const uint8_t*)(p))
+#define pgm_read_word(p)  (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+#define pgm_read_ptr(p)   (*(void* const*)(p))
+
+#define memcpy_P    memcpy
+#define strcpy_P    strcpy
+#define strncpy_P   strncpy
+#define strcmp_P    strcmp
+#define strncmp_P   strncmp
+#define strlen_P    strlen
+#define strchr_P    strchr
+#define strstr_P    strstr
+#define sprintf_P   sprintf
+#define snprintf_P  snprintf
+
+#endif /* AVR_PGMSPACE_H */
@@ -0,0 +1,32 @@
+/**
+  avr/sleep.h - No sleep modes on the host
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AVR_SLEEP_H
+#define AVR_SLEEP_H
+
+#define SLEEP_MODE_IDLE     0
+#define SLEEP_MODE_PWR_DOWN 2
+
+static inline void set_sleep_mode(int) {}
+static inline void sleep_enable() {}
+static inline void sleep_disable() {}
+static inline void sleep_cpu() {}
+static inline void sleep_mode() {}
+
+#endif /* AVR_SLEEP_H */
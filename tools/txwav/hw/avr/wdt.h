@@ -0,0 +1,28 @@
+/**
+  avr/wdt.h - No watchdog on the host
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AVR_WDT_H
+#define AVR_WDT_H
+
+#define WDTO_250MS 4
+
+static inline void wdt_enable(int) {}
+static inline void wdt_reset() {}
+
+#endif /* AVR_WDT_H */
@@ -0,0 +1,27 @@
+/**
+  util/atomic.h - Everything is atomic on the host
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UTIL_ATOMIC_H
+#define UTIL_ATOMIC_H
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON      1
+#define ATOMIC_BLOCK(type) for (int _atomic = 1; _atomic; _atomic = 0)
+
+#endif /* UTIL_ATOMIC_H */
@@ -0,0 +1,174 @@
+/**
+  resample.cpp - Streaming polyphase resampler with anti-aliasing low-pass
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "resample.h"
+
+RESAMPLE::RESAMPLE() {
+}
+
+RESAMPLE::~RESAMPLE() {
+  free(phs);
+}
+
+/**
+  Compute the filter for the rates
+
+  @param rateIn the input sampling rate
+  @param rateOut the output sampling rate
+  @return false if the ratio needs more than RSM_MAX_L phases
+*/
+bool RESAMPLE::init(uint32_t rateIn, uint32_t rateOut) {
+  // Reduce the ratio
+  uint32_t a = rateIn, b = rateOut;
+  while (b != 0) {
+    uint32_t t = a % b;
+    a = b;
+    b = t;
+  }
+  L = rateOut / a;
+  M = rateIn / a;
+  if (L > RSM_MAX_L)
+    return false;
+  phs = (float*)malloc(L * RSM_TAPS * sizeof(float));
+  if (phs == nullptr)
+    return false;
+  // The transition band of the Kaiser window (in input samples), the
+  // cut-off half of it below the lower Nyquist frequency
+  double fny = 0.5 * (rateIn < rateOut ? rateIn : rateOut) / rateIn;
+  double att = RSM_BETA / 0.1102 + 8.7;
+  double trn = (att - 7.95) / (14.36 * RSM_TAPS);
+  double fc  = fny - trn / 2;
+  // The windowed sinc, at the upsampled rate, the phases interleaved; odd
+  // length, the last coefficient left out, for a delay of whole samples
+  uint32_t len = L * RSM_TAPS;
+  uint32_t ctr = len / 2 - 1;
+  double sum = 0;
+  for (uint32_t k = 0; k < len; k++) {
+    double h = 0;
+    if (k <= 2 * ctr) {
+      double t = ((double)k - ctr) / L;
+      double r = ((double)k - ctr) / ctr;
+      h = 2 * fc * (t == 0 ? 1.0 : sin(2 * M_PI * fc * t) / (2 * M_PI * fc * t));
+      h *= bessel(RSM_BETA * sqrt(1 - r * r)) / bessel(RSM_BETA);
+    }
+    // Keep each phase in a row: phase k % L, tap k / L
+    phs[(k % L) * RSM_TAPS + k / L] = h;
+    sum += h;
+  }
+  // Unity gain at DC, for each output sample
+  for (uint32_t k = 0; k < len; k++)
+    phs[k] *= L / sum;
+  // The first output sample is at the filter centre: no delay
+  pos = ctr;
+  memset(hst, 0, sizeof(hst));
+  return true;
+}
+
+/**
+  The most output samples a single input sample can produce
+
+  @return the size of the output buffer for feed and flush
+*/
+uint16_t RESAMPLE::maxOut() {
+  return (L + M - 1) / M + 1;
+}
+
+/**
+  Take one input sample, compute the output samples it completes
+
+  @param x the input sample
+  @param out the output samples
+  @return the number of output samples
+*/
+uint16_t RESAMPLE::feed(float x, float *out) {
+  uint16_t n = 0;
+  // Keep the newest input sample
+  idx = (idx + 1) % RSM_TAPS;
+  hst[idx] = x;
+  cnt++;
+  // Compute the output samples up to this input sample
+  while (pos / L < cnt) {
+    float y = this->compute();
+    pos += M;
+    out[n++] = y;
+    done++;
+  }
+  return n;
+}
+
+/**
+  Push the last input samples out of the filter, with silence, one input
+  sample at a time, until the output lasts as long as the input
+
+  @param out the output samples
+  @return the number of output samples, 0 when done
+*/
+uint16_t RESAMPLE::flush(float *out) {
+  // As many output samples as the input lasted, rounded up
+  if (total == 0)
+    total = (cnt * L + M - 1) / M;
+  // Feed silence until something comes out, or it is all out
+  uint16_t n = 0;
+  while (n == 0 and done < total)
+    n = this->feed(0.0, out);
+  // Do not overshoot
+  if (done > total) {
+    n -= done - total;
+    done = total;
+  }
+  return n;
+}
+
+/**
+  Compute the output sample at the current position
+
+  @return the output sample
+*/
+float RESAMPLE::compute() {
+  // The filter phase and the newest input sample it takes
+  const float *h = &phs[(pos % L) * RSM_TAPS];
+  uint64_t q = pos / L;
+  // The newest sample we have is cnt - 1
+  uint8_t j = (idx + RSM_TAPS - (cnt - 1 - q)) % RSM_TAPS;
+  float y = 0;
+  for (uint8_t i = 0; i < RSM_TAPS; i++) {
+    y += h[i] * hst[j];
+    j = (j + RSM_TAPS - 1) % RSM_TAPS;
+  }
+  return y;
+}
+
+/**
+  Modified Bessel function of the first kind, order zero
+
+  @param x the argument
+  @return I0(x)
+*/
+double RESAMPLE::bessel(double x) {
+  double sum = 1, trm = 1;
+  for (uint8_t k = 1; k < 32; k++) {
+    trm *= (x / (2 * k)) * (x / (2 * k));
+    sum += trm;
+  }
+  return sum;
+}
@@ -0,0 +1,65 @@
+/**
+  resample.h - Streaming polyphase resampler with anti-aliasing low-pass
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <stdint.h>
+
+// Filter taps for each phase, the span of the filter in input samples
+#define RSM_TAPS    64
+// Kaiser window parameter, about 80dB stop band attenuation
+#define RSM_BETA    7.86
+// The resampling ratio is reduced to L/M, with L at most this
+#define RSM_MAX_L   1000
+
+/*
+  The input is upsampled by L, low-pass filtered and decimated by M, all
+  at once: only the filter phase needed for each output sample is
+  computed.  The low-pass ends its transition band at half the lower of
+  the two rates, so that neither the images of the input (upsampling) nor
+  the aliases (downsampling) make it to the output.  The output starts
+  at the filter centre, aligned to the input, with no delay.
+*/
+class RESAMPLE {
+  public:
+    RESAMPLE();
+    ~RESAMPLE();
+
+    bool     init(uint32_t rateIn, uint32_t rateOut);
+    uint16_t maxOut();
+    uint16_t feed(float x, float *out);
+    uint16_t flush(float *out);
+
+  private:
+    uint32_t L = 1;             // upsampling factor
+    uint32_t M = 1;             // downsampling factor
+    float   *phs = nullptr;     // the filter, RSM_TAPS coefficients for each phase
+    float    hst[RSM_TAPS];     // the last input samples, circular
+    uint8_t  idx = 0;           // position of the newest input sample
+    uint64_t cnt = 0;           // input samples received
+    uint64_t pos = 0;           // next output sample position, upsampled
+    uint64_t done = 0;          // output samples delivered
+    uint64_t total = 0;         // output samples to deliver, known when flushing
+
+    float    compute();
+    double   bessel(double x);
+};
+
+#endif /* RESAMPLE_H */
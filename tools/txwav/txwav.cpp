@@ -0,0 +1,262 @@
+/**
+  txwav.cpp - Render bytes to WAV with the modem's own TX modulator
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  The modem sources are built for the host: the input bytes come in on
+  the serial port and are taken by the data mode (AFSK::doData), the
+  sample ISR (AFSK::doTXRX) is called once for each sample period and the
+  TX sample is read from the DAC register, with the carrier preamble, the
+  start/stop framing and the trail exactly as txHandle sends them.  The
+  input is read as the modem takes it and the output written as it goes,
+  so any input size renders in constant memory.
+
+    txwav [-v] [-a] [-c bits] [-b 8|16] [-r rate] input output.wav
+
+    -v        V.21 instead of Bell 103
+    -a        answering instead of originating
+    -c bits   carrier bits of preamble and trail (default 240)
+    -b 8|16   bits per sample (default 16)
+    -r rate   resample to this rate (default F_SAMPLE)
+
+  The input may be '-', the standard input.
+*/
+
+#include <unistd.h>
+
+#include <Arduino.h>
+#include "afsk.h"
+#include "resample.h"
+#include "wavfile.h"
+
+// The registers
+#define REG8(r)  volatile uint8_t  r;
+#define REG16(r) volatile uint16_t r;
+REG8(ADCH)   REG8(ADCL)   REG8(ADCSRA) REG8(ADCSRB) REG8(ADMUX)  REG8(DIDR0)
+REG8(ASSR)   REG8(TCCR1A) REG8(TCCR1B) REG8(TCCR2A) REG8(TCCR2B) REG8(TIMSK0)
+REG8(TIMSK1) REG8(TIFR1)  REG8(OCR2A)  REG8(OCR2B)  REG16(ICR1)  REG16(TCNT1)
+REG8(DDRB)   REG8(DDRC)   REG8(DDRD)   REG8(PORTB)  REG8(PORTC)  REG8(PORTD)
+REG8(PINB)   REG8(PIND)   REG8(EICRA)  REG8(EIMSK)  REG8(EIFR)   REG8(PCICR)
+REG8(PCMSK2) REG8(PCIFR)  REG8(SMCR)   REG8(MCUCR)  REG8(PRR)
+
+// The serial port, reading the input file
+HardwareSerial Serial;
+// The EEPROM, blank
+EEPROMClass EEPROM;
+
+// The configuration
+CFG_t cfg;
+// The modem
+AFSK afsk;
+
+// The input
+FILE *input;
+// Sample periods elapsed, the time base
+uint64_t ticks = 0;
+
+/**
+  The time, in sample periods
+
+  @return milliseconds since start
+*/
+unsigned long millis() {
+  return ticks * 1000 / F_SAMPLE;
+}
+
+/**
+  The time, in sample periods
+
+  @return microseconds since start
+*/
+unsigned long micros() {
+  return ticks * 1000000 / F_SAMPLE;
+}
+
+/**
+  Nothing waits here, the time only goes on with the samples
+*/
+void delay(unsigned long) {
+}
+
+/**
+  Check the input, blocking until there is some or the end of it
+
+  @return 1 if there is a byte to read, 0 at the end
+*/
+int HardwareSerial::available() {
+  return this->peek() == EOF ? 0 : 1;
+}
+
+/**
+  Get the next input byte, leaving it in
+
+  @return the byte or EOF
+*/
+int HardwareSerial::peek() {
+  int c = getc(input);
+  if (c != EOF)
+    ungetc(c, input);
+  return c;
+}
+
+/**
+  Get the next input byte
+
+  @return the byte or EOF
+*/
+int HardwareSerial::read() {
+  return getc(input);
+}
+
+/**
+  The modem has nothing to say while rendering, drop the byte
+
+  @return always 1
+*/
+size_t HardwareSerial::write(uint8_t) {
+  return 1;
+}
+
+/**
+  Print the usage and exit
+*/
+void usage() {
+  fprintf(stderr, "Usage: txwav [-v] [-a] [-c bits] [-b 8|16] [-r rate] input output.wav\n");
+  exit(2);
+}
+
+int main(int argc, char *argv[]) {
+  AFSK_t   type = BELL103;
+  uint8_t  dir  = ORIGINATING;
+  int      cbits = -1;
+  int      bits = 16;
+  long     rate = F_SAMPLE;
+  int      opt;
+
+  // The options
+  while ((opt = getopt(argc, argv, "vac:b:r:")) != -1) {
+    switch (opt) {
+      case 'v':
+        type = V_21;
+        break;
+      case 'a':
+        dir = ANSWERING;
+        break;
+      case 'c':
+        cbits = atoi(optarg);
+        if (cbits < 1 or cbits > 255) usage();
+        break;
+      case 'b':
+        bits = atoi(optarg);
+        if (bits != 8 and bits != 16) usage();
+        break;
+      case 'r':
+        rate = atol(optarg);
+        if (rate < 1000 or rate > 192000) usage();
+        break;
+      default:
+        usage();
+    }
+  }
+  if (argc - optind != 2)
+    usage();
+
+  // The input and the output
+  input = strcmp(argv[optind], "-") == 0 ? stdin : fopen(argv[optind], "rb");
+  if (input == NULL) {
+    perror(argv[optind]);
+    return 1;
+  }
+  WAVFILE wav;
+  if (not wav.open(argv[optind + 1], bits, rate)) {
+    perror(argv[optind + 1]);
+    return 1;
+  }
+  RESAMPLE rsm;
+  if (rate != F_SAMPLE and not rsm.init(F_SAMPLE, rate)) {
+    fprintf(stderr, "txwav: cannot resample from %d to %ld Hz\n", F_SAMPLE, rate);
+    return 1;
+  }
+  float *buf = new float[rsm.maxOut()];
+
+  // The factory profile, with no escape sequence and no BREAK detection:
+  // the input is sent as it is, '+' included
+  Profile profile;
+  profile.factory(&cfg);
+  cfg.sregs[13] = ESC_NONE;
+  // The modem, online, in data mode
+  afsk.init(type, &cfg);
+  afsk.setDirection(dir);
+  if (cbits > 0)
+    afsk.carBits = cbits;
+  afsk.setLine(ON);
+  afsk.setMode(DATA_MODE);
+
+  // Started sending, the TX led has been on
+  bool started = false, lit = false;
+  // Sample periods with all the input taken and the TX led off
+  uint32_t idle = 0;
+  while (true) {
+    // Take the input bytes, as the data task does
+    if (afsk.hasData()) {
+      afsk.doData();
+      started = true;
+    }
+    // One sample period, on a silent line
+    for (uint8_t i = 0; i < ADC_OVS; i++) {
+      ADCH = 0x80;
+      afsk.doTXRX();
+    }
+    ticks++;
+    if (not started) {
+      // Nothing to send at all
+      if (not Serial.available())
+        break;
+      continue;
+    }
+    // The TX sample, on the DAC txHandle writes to (&J0)
+    if (rate == F_SAMPLE)
+      wav.put(((int16_t)OCR2A - 0x80) << 8);
+    else {
+      uint16_t n = rsm.feed(((int16_t)OCR2A - 0x80) / 128.0, buf);
+      for (uint16_t i = 0; i < n; i++)
+        wav.put(lround(constrain(buf[i], -1.0, 32767 / 32768.0) * 32768));
+    }
+    // The TX led is on from the preamble to the end of the trail
+    if (PORTB & _BV(PORTB1))
+      lit = true;
+    else if (lit)
+      break;
+    // Safety net: all the input taken, but the TX led did not come on
+    // within a few bit times
+    else if (not Serial.available() and ++idle > 4UL * F_SAMPLE / type.baud)
+      break;
+  }
+  // The filter delay
+  if (rate != F_SAMPLE) {
+    uint16_t n;
+    while ((n = rsm.flush(buf)) > 0)
+      for (uint16_t i = 0; i < n; i++)
+        wav.put(lround(constrain(buf[i], -1.0, 32767 / 32768.0) * 32768));
+  }
+  delete[] buf;
+
+  if (not wav.close()) {
+    perror(argv[optind + 1]);
+    return 1;
+  }
+  return 0;
+}
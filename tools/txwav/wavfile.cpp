@@ -0,0 +1,109 @@
+/**
+  wavfile.cpp - Mono PCM WAV writer, 8 bits unsigned or 16 bits signed
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "wavfile.h"
+
+WAVFILE::WAVFILE() {
+}
+
+WAVFILE::~WAVFILE() {
+  this->close();
+}
+
+/**
+  Create the WAV file, the header is completed on close
+
+  @param name the file name
+  @param bits bits per sample, 8 or 16
+  @param rate the sampling rate
+  @return true if the file could be created
+*/
+bool WAVFILE::open(const char *name, uint8_t bits, uint32_t rate) {
+  fp = fopen(name, "wb");
+  if (fp == nullptr)
+    return false;
+  this->bits = bits;
+  count = 0;
+  // RIFF header, the sizes are set on close
+  fputs("RIFF", fp);
+  le(0, 4);
+  fputs("WAVE", fp);
+  // Format chunk: PCM, mono
+  fputs("fmt ", fp);
+  le(16, 4);
+  le(1, 2);
+  le(1, 2);
+  le(rate, 4);
+  le(rate * (bits / 8), 4);
+  le(bits / 8, 2);
+  le(bits, 2);
+  // Data chunk
+  fputs("data", fp);
+  le(0, 4);
+  return true;
+}
+
+/**
+  Write one sample
+
+  @param sample the signed 16 bits sample, its top byte for 8 bits
+*/
+void WAVFILE::put(int16_t sample) {
+  if (bits == 8)
+    fputc((uint8_t)((sample >> 8) + 0x80), fp);
+  else
+    le((uint16_t)sample, 2);
+  count++;
+}
+
+/**
+  Set the chunk sizes and close the file
+
+  @return true if the file was written entirely
+*/
+bool WAVFILE::close() {
+  if (fp == nullptr)
+    return true;
+  uint32_t size = count * (bits / 8);
+  // Pad the data chunk to an even size
+  if (size & 1)
+    fputc(0, fp);
+  // The RIFF and the data chunk sizes
+  fseek(fp, 4, SEEK_SET);
+  le(36 + size + (size & 1), 4);
+  fseek(fp, 40, SEEK_SET);
+  le(size, 4);
+  bool ok = not ferror(fp);
+  ok = (fclose(fp) == 0) and ok;
+  fp = nullptr;
+  return ok;
+}
+
+/**
+  Write a value, little endian
+
+  @param val the value
+  @param len its length in bytes
+*/
+void WAVFILE::le(uint32_t val, uint8_t len) {
+  while (len--) {
+    fputc(val & 0xFF, fp);
+    val >>= 8;
+  }
+}
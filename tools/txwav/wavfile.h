@@ -0,0 +1,43 @@
+/**
+  wavfile.h - Mono PCM WAV writer, 8 bits unsigned or 16 bits signed
+
+  Copyright (C) 2018 Costin STROIE <costinstroie@eridu.eu.org>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WAVFILE_H
+#define WAVFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+class WAVFILE {
+  public:
+    WAVFILE();
+    ~WAVFILE();
+
+    bool open(const char *name, uint8_t bits, uint32_t rate);
+    void put(int16_t sample);
+    bool close();
+
+  private:
+    FILE    *fp   = nullptr;
+    uint8_t  bits = 16;       // bits per sample
+    uint32_t count = 0;       // samples written
+
+    void     le(uint32_t val, uint8_t len);
+};
+
+#endif /* WAVFILE_H */
@@ -19,6 +19,61 @@
 
 #include "wave.h"
 
+// Unfold the quarter wave LUT at compile time: mirror the second
+// quarter, invert the second half
+#define WAVE_HLF(i) ((i) < 64 ? wavelut[(i)] : wavelut[127 - (i)])
+#define WAVE_FUL(i) ((i) < 128 ? WAVE_HLF(i) : 0xFF - WAVE_HLF((i) - 128))
+#define WAVE_4(i)   WAVE_FUL(i), WAVE_FUL(i + 1), WAVE_FUL(i + 2), WAVE_FUL(i + 3)
+#define WAVE_16(i)  WAVE_4(i), WAVE_4(i + 4), WAVE_4(i + 8), WAVE_4(i + 12)
+#define WAVE_64(i)  WAVE_16(i), WAVE_16(i + 16), WAVE_16(i + 32), WAVE_16(i + 48)
+
+// The full wave samples LUT
+#ifdef WAVE_SRAM
+const uint8_t wavefull[256] = {
+#else
+const uint8_t wavefull[256] PROGMEM = {
+#endif
+  WAVE_64(0), WAVE_64(64), WAVE_64(128), WAVE_64(192)
+};
+
+#ifdef TX_NOISE_SHAPING
+// The full wave signed samples LUT, amplitude 125 (Q8)
+const int16_t wavefine[256] PROGMEM = {
+       0,    785,   1570,   2354,   3137,   3917,   4695,   5471,
+    6243,   7011,   7775,   8535,   9289,  10038,  10780,  11517,
+   12246,  12968,  13682,  14388,  15085,  15773,  16451,  17120,
+   17778,  18426,  19062,  19687,  20301,  20902,  21490,  22065,
+   22627,  23176,  23710,  24231,  24736,  25227,  25703,  26163,
+   26607,  27035,  27447,  27843,  28221,  28583,  28928,  29255,
+   29564,  29856,  30129,  30385,  30622,  30841,  31041,  31222,
+   31385,  31529,  31654,  31759,  31846,  31913,  31961,  31990,
+   32000,  31990,  31961,  31913,  31846,  31759,  31654,  31529,
+   31385,  31222,  31041,  30841,  30622,  30385,  30129,  29856,
+   29564,  29255,  28928,  28583,  28221,  27843,  27447,  27035,
+   26607,  26163,  25703,  25227,  24736,  24231,  23710,  23176,
+   22627,  22065,  21490,  20902,  20301,  19687,  19062,  18426,
+   17778,  17120,  16451,  15773,  15085,  14388,  13682,  12968,
+   12246,  11517,  10780,  10038,   9289,   8535,   7775,   7011,
+    6243,   5471,   4695,   3917,   3137,   2354,   1570,    785,
+       0,   -785,  -1570,  -2354,  -3137,  -3917,  -4695,  -5471,
+   -6243,  -7011,  -7775,  -8535,  -9289, -10038, -10780, -11517,
+  -12246, -12968, -13682, -14388, -15085, -15773, -16451, -17120,
+  -17778, -18426, -19062, -19687, -20301, -20902, -21490, -22065,
+  -22627, -23176, -23710, -24231, -24736, -25227, -25703, -26163,
+  -26607, -27035, -27447, -27843, -28221, -28583, -28928, -29255,
+  -29564, -29856, -30129, -30385, -30622, -30841, -31041, -31222,
+  -31385, -31529, -31654, -31759, -31846, -31913, -31961, -31990,
+  -32000, -31990, -31961, -31913, -31846, -31759, -31654, -31529,
+  -31385, -31222, -31041, -30841, -30622, -30385, -30129, -29856,
+  -29564, -29255, -28928, -28583, -28221, -27843, -27447, -27035,
+  -26607, -26163, -25703, -25227, -24736, -24231, -23710, -23176,
+  -22627, -22065, -21490, -20902, -20301, -19687, -19062, -18426,
+  -17778, -17120, -16451, -15773, -15085, -14388, -13682, -12968,
+  -12246, -11517, -10780, -10038,  -9289,  -8535,  -7775,  -7011,
+   -6243,  -5471,  -4695,  -3917,  -3137,  -2354,  -1570,   -785
+};
+#endif
+
 WAVE::WAVE() {
 }
 
@@ -26,41 +81,40 @@ WAVE::~WAVE() {
 }
 
 /**
-  Get an instant wave sample
-
-  @param idx the wave sample index
-*/
-uint8_t WAVE::sample(uint8_t idx) {
-  // Work on half wave
-  uint8_t hIdx = idx & 0x7F;
-  // Check if in second quarter wave
-  if (hIdx >= qart)
-    // Descending slope
-    hIdx = half - hIdx - 1;
-  // Get the value
-  uint8_t result = wavelut[hIdx];
-  // Check if in second half wave
-  if (idx >= half)
-    // Under X axis
-    result = 0xFF - result;
-  return result;
-}
-
-/**
-  Get an instant wave sample
+  Compute the samples step for the given frequency, as Q8.8 or Q8.24,
+  rounded to nearest.  The division is done in two 16 bits steps, so
+  it fits 32 bits arithmetic.
 
-  @param idx the wave sample index as Q8.8
+  @param freq the frequency
+  @return the step
 */
-uint8_t WAVE::sample(uint16_t idx) {
-  return this->sample((uint8_t)(idx / 256));
+phase_t WAVE::getStep(uint16_t freq) {
+  // The step is freq / F_SAMPLE of the full wave, Q8.8 ...
+  uint32_t q = ((uint32_t)freq * this->full << 8) / F_SAMPLE;
+  uint32_t r = ((uint32_t)freq * this->full << 8) % F_SAMPLE;
+#if WAVE_PHASE_BITS == 32
+  // ... then extended with 16 more fractional bits
+  return (q << 16) + ((r << 16) + F_SAMPLE / 2) / F_SAMPLE;
+#else
+  return q + (r >= F_SAMPLE / 2 ? 1 : 0);
+#endif
 }
 
+#ifdef TX_NOISE_SHAPING
 /**
-  Compute the samples step for the given frequency, as Q8.8
+  Get an instant signed wave sample, with 8 fractional bits, linearly
+  interpolated between the fine wave LUT entries using the phase bits
+  below the top byte
 
-  @param freq the frequency
-  @return the step
+  @param idx the wave phase
+  @return the signed sample (Q8)
 */
-uint16_t WAVE::getStep(uint16_t freq) {
-  return (uint16_t)(((uint32_t)freq * this->full * (1 << 9) / F_SAMPLE + 1) >> 1);
+int16_t WAVE::sampleFine(phase_t idx) {
+  // The LUT index and the fraction towards the next entry
+  uint8_t i = idx >> (WAVE_PHASE_BITS - 8);
+  uint8_t f = idx >> (WAVE_PHASE_BITS - 16);
+  int16_t s0 = pgm_read_word(&wavefine[i]);
+  int16_t s1 = pgm_read_word(&wavefine[(uint8_t)(i + 1)]);
+  return s0 + (((int32_t)(s1 - s0) * f) >> 8);
 }
+#endif
@@ -23,8 +23,21 @@
 #include <Arduino.h>
 #include "config.h"
 
+// Wave phase accumulator width: 16 (Q8.8) or 32 (Q8.24) bits; only the
+// top 8 bits index the wave table, the rest keep the tone frequency
+#ifndef WAVE_PHASE_BITS
+#define WAVE_PHASE_BITS 16
+#endif
+
+// Wave phase accumulator (and step) type
+#if WAVE_PHASE_BITS == 32
+typedef uint32_t phase_t;
+#else
+typedef uint16_t phase_t;
+#endif
+
 // The first quarter wave samples LUT
-static const uint8_t wavelut[] = {
+static constexpr uint8_t wavelut[] = {
   0x80, 0x83, 0x86, 0x89, 0x8c, 0x8f, 0x92, 0x95,
   0x98, 0x9b, 0x9e, 0xa2, 0xa5, 0xa7, 0xaa, 0xad,
   0xb0, 0xb3, 0xb6, 0xb9, 0xbc, 0xbe, 0xc1, 0xc4,
@@ -35,6 +48,18 @@ static const uint8_t wavelut[] = {
   0xfd, 0xfd, 0xfe, 0xfe, 0xfe, 0xff, 0xff, 0xff
 };
 
+// The full wave samples LUT, in flash or, if WAVE_SRAM, in SRAM
+#ifdef WAVE_SRAM
+extern const uint8_t wavefull[256];
+#else
+extern const uint8_t wavefull[256] PROGMEM;
+#endif
+
+#ifdef TX_NOISE_SHAPING
+// The full wave signed samples LUT, with 8 fractional bits
+extern const int16_t wavefine[256] PROGMEM;
+#endif
+
 class WAVE {
   public:
     // Samples count for quarter, half and full wave
@@ -46,12 +71,29 @@ class WAVE {
     ~WAVE();
 
     // Get the wave sample specified by index
-    uint8_t sample(uint8_t idx);
+    inline uint8_t sample(uint8_t idx) {
+#ifdef WAVE_SRAM
+      return wavefull[idx];
+#else
+      return pgm_read_byte(&wavefull[idx]);
+#endif
+    }
     // Get the wave sample specified by index in Q8.8 format
-    uint8_t sample(uint16_t idx);
+    inline uint8_t sample(uint16_t idx) {
+      return this->sample((uint8_t)(idx >> 8));
+    }
+    // Get the wave sample specified by index in Q8.24 format
+    inline uint8_t sample(uint32_t idx) {
+      return this->sample((uint8_t)(idx >> 24));
+    }
+
+#ifdef TX_NOISE_SHAPING
+    // Get the interpolated signed wave sample with 8 fractional bits
+    int16_t sampleFine(phase_t idx);
+#endif
 
-    // Compute the wave steps as Q8.8
-    uint16_t getStep(uint16_t freq);
+    // Compute the wave steps as phase_t
+    phase_t getStep(uint16_t freq);
 };
 
 #endif /* WAVE_H */